@@ -0,0 +1,279 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "button_clicks.hpp"
+#include "button_hold.hpp"
+#include "button_machine.hpp"
+#include "button_state.hpp"
+#include "button_stats.hpp"
+#include "button_trace.hpp"
+#include "common.hpp"
+#include "gpio.hpp"
+#include "timer.hpp"
+
+class ButtonChords;
+class EdgeCapture;
+
+#include <functional>
+#include <memory>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/object.hpp>
+#include <string>
+
+/**
+ * @class ButtonBase
+ *
+ * The part of a button that does not depend on its D-Bus interface:
+ * it owns the GPIO line and its event source, runs every edge through
+ * its ButtonMachine and hands the actions to the derived class to
+ * emit.  One timer on the loop runs the timers of the machine.
+ *
+ * While the button is held down each hold tier is reported as it is
+ * reached, the first one as a long press.  With a click window, the
+ * gesture of quick presses is reported once it is over, and only a
+ * single press is also reported as released, see ButtonMachine.  A button
+ * engaged in a chord holds all of these back, see ChordTracker.
+ *
+ * The line is read from the event loop, or from the thread of an
+ * EdgeCapture, which passes the edges back to the loop.  Everything
+ * past the read runs on the loop either way.
+ */
+class ButtonBase : public ButtonMachine
+{
+  public:
+    /**
+     * @brief Called with every action, after its signal is emitted
+     */
+    using ActionListener = std::function<void(ButtonAction action)>;
+
+    ButtonBase() = delete;
+    ButtonBase(const ButtonBase&) = delete;
+    ButtonBase& operator=(const ButtonBase&) = delete;
+    ButtonBase(ButtonBase&&) = delete;
+    ButtonBase& operator=(ButtonBase&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * Adds the GPIO line to the event loop.  The line is configured
+     * beforehand by configGpio(), so the lines of several buttons can
+     * be brought up at once.
+     *
+     * @param[in] bus - sdbusplus connection object
+     * @param[in] path - the button object path
+     * @param[in] event - the sd_event loop
+     * @param[in] gpioDefs - the GPIO definitions
+     * @param[in] line - the configured GPIO line
+     * @param[in] gpioName - the GPIO name, e.g. POWER_BUTTON
+     * @param[in] policy - the button policy, completed with the
+     *                     settings from the GPIO definition
+     *
+     * @throw IOError if there is no line or it can't be watched
+     */
+    ButtonBase(sdbusplus::bus::bus& bus, const char* path, EventPtr& event,
+               const GpioDefinitions& gpioDefs,
+               std::unique_ptr<GpioLine> line, const std::string& gpioName,
+               const ButtonPolicy& policy);
+
+    virtual ~ButtonBase();
+
+    /**
+     * @brief Records the edges read from the line from now on
+     *
+     * @param[in] trace - the trace, which must outlive the button
+     */
+    void recordTo(TraceWriter& trace);
+
+    /**
+     * @brief Hands the line over to a capture thread, which reads it
+     *        instead of the event loop from now on
+     *
+     * If the capture can't take the line, the loop keeps reading it.
+     *
+     * @param[in] capture - the started capture, which must outlive
+     *                      the button
+     */
+    void captureWith(EdgeCapture& capture);
+
+    /**
+     * @brief Reports the presses and releases of the button to the
+     *        chords, if it is part of any
+     *
+     * @param[in] chords - the chords, which must outlive the button
+     */
+    void chordWith(ButtonChords& chords);
+
+    /**
+     * @brief Also passes every action to a listener in the process,
+     *        e.g. the button handler
+     *
+     * @param[in] listener - the listener
+     */
+    void forwardTo(ActionListener listener);
+
+    /**
+     * @brief Processes the edges read from the line
+     *
+     * @param[in] events - the edges, oldest first
+     * @param[in] n - the number of edges
+     */
+    void edgesRead(const GpioEvent* events, int n);
+
+    /**
+     * @brief Accounts for a failed read of the line
+     *
+     * @param[in] error - the errno of the read
+     */
+    void readFailed(int error);
+
+  protected:
+    /**
+     * @brief Emits the D-Bus signal for an action
+     *
+     * @param[in] action - the action, never ButtonAction::none
+     */
+    virtual void emit(ButtonAction action) = 0;
+
+    /**
+     * @brief Emits an action and passes it to the listener, if any
+     */
+    void deliver(ButtonAction action);
+
+    void send(ButtonAction action, bool heldBack) override;
+
+    void held(uint8_t tier) override;
+
+    void clicked(uint8_t count) override;
+
+    void classified(ButtonAction action, const GpioEvent& event,
+                    bool sent) override;
+
+    bool chordLevel(bool pressed, uint64_t timestamp) override;
+
+    bool chordEngaged() const override;
+
+  private:
+    static int EventHandler(sd_event_source* es, int fd, uint32_t revents,
+                            void* userdata);
+
+    /**
+     * @brief Called when the next timer of the machine may be due
+     */
+    void timeout(uint64_t now);
+
+    /**
+     * @brief Arms the timer for the next timer of the machine, or
+     *        cancels it if there is none
+     */
+    void updateTimer();
+
+    /**
+     * @brief The CLOCK_MONOTONIC time of the current loop iteration
+     */
+    uint64_t now() const;
+
+    std::string gpioName;
+    sd_event* loop;
+    std::unique_ptr<GpioLine> line;
+    sd_event_source* source = nullptr;
+    ButtonStatistics statistics;
+    Timer timer;
+    std::unique_ptr<ButtonHold> hold;
+    std::unique_ptr<ButtonClicks> clicks;
+    TraceWriter* trace = nullptr;
+    uint16_t traceLine = 0;
+    ActionListener listener;
+    ButtonChords* chords = nullptr;
+    uint8_t chordBit = 0;
+    // Reads of the line that failed since the last one that didn't
+    unsigned failedReads = 0;
+};
+
+/**
+ * @class Button
+ *
+ * A button object on D-Bus.  Traits provides:
+ *  - Interface: the sdbusplus server interface of the button
+ *  - type: the button type used in the buttons config array
+ *  - gpioName: the default name of its GPIO in the GPIO definitions
+ *  - objectPath: the object path the instance number is appended to
+ *  - longPress: whether long presses are reported with pressedLong()
+ */
+template <typename Traits>
+class Button :
+    public sdbusplus::server::object::object<typename Traits::Interface>,
+    public ButtonBase
+{
+  public:
+    using ButtonTraits = Traits;
+
+    Button(sdbusplus::bus::bus& bus, const char* path, EventPtr& event,
+           const GpioDefinitions& gpioDefs, std::unique_ptr<GpioLine> line,
+           const std::string& gpioName = Traits::gpioName) :
+        sdbusplus::server::object::object<typename Traits::Interface>(bus,
+                                                                      path),
+        ButtonBase(bus, path, event, gpioDefs, std::move(line), gpioName,
+                   makePolicy())
+    {
+    }
+
+    void simPress() override
+    {
+        this->deliver(ButtonAction::pressed);
+    }
+
+    static const char* getGpioName()
+    {
+        return Traits::gpioName;
+    }
+
+  protected:
+    void emit(ButtonAction action) override
+    {
+        switch (action)
+        {
+            case ButtonAction::pressed:
+                this->pressed();
+                break;
+            case ButtonAction::released:
+                this->released();
+                break;
+            case ButtonAction::pressedLong:
+                if constexpr (Traits::longPress)
+                {
+                    this->pressedLong();
+                }
+                break;
+            case ButtonAction::none:
+                break;
+        }
+    }
+
+  private:
+    static ButtonPolicy makePolicy()
+    {
+        // The GPIO definition may replace this with its own tiers
+        ButtonPolicy policy;
+        policy.longPress = Traits::longPress;
+        if constexpr (Traits::longPress)
+        {
+            policy.holdTimes[0] = LONG_PRESS_TIME_MS * 1000000ULL;
+            policy.holdTiers = 1;
+        }
+        return policy;
+    }
+};
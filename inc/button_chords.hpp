@@ -0,0 +1,103 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "chord_tracker.hpp"
+#include "common.hpp"
+#include "gpio.hpp"
+#include "timer.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+#include <string>
+#include <vector>
+
+static constexpr auto buttonChordsIface =
+    "xyz.openbmc_project.Chassis.Buttons.Chords";
+static constexpr auto buttonChordsPath =
+    "/xyz/openbmc_project/Chassis/Buttons/Chords";
+
+/**
+ * @class ButtonChords
+ *
+ * Sends a ChordPressed signal for the chords of gpio_defs.json that
+ * the ChordTracker finds.  One timer, for the chord currently held,
+ * covers the hold times of all of them.
+ */
+class ButtonChords
+{
+  public:
+    ButtonChords() = delete;
+    ButtonChords(const ButtonChords&) = delete;
+    ButtonChords& operator=(const ButtonChords&) = delete;
+    ButtonChords(ButtonChords&&) = delete;
+    ButtonChords& operator=(ButtonChords&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * Chords that need too many buttons, or the same buttons as an
+     * earlier chord, are logged and skipped.
+     *
+     * @param[in] bus - sdbusplus connection object
+     * @param[in] event - the sd_event loop
+     * @param[in] chords - the chord definitions
+     */
+    ButtonChords(sdbusplus::bus::bus& bus, EventPtr& event,
+                 const std::vector<ChordDefinition>& chords);
+
+    /**
+     * @brief The bit of a button in the level mask
+     *
+     * @param[in] gpioName - the GPIO name of the button
+     *
+     * @return the bit, or std::nullopt if the button is in no chord
+     */
+    std::optional<uint8_t> bit(const std::string& gpioName) const
+    {
+        return tracker.bit(gpioName);
+    }
+
+    /**
+     * @brief Updates the level of a button, see ChordTracker::level()
+     */
+    bool level(uint8_t bit, bool pressed, uint64_t timestamp);
+
+    /**
+     * @brief Whether a button is engaged in a chord, see
+     *        ChordTracker::engaged()
+     */
+    bool engaged(uint8_t bit) const
+    {
+        return tracker.engaged(bit);
+    }
+
+  private:
+    /**
+     * @brief Signals the chord held if it is held long enough, and
+     *        arms the timer for it if not
+     */
+    void update(uint64_t now);
+
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    sdbusplus::server::interface::interface chordsIface;
+    ChordTracker tracker;
+    Timer holdTimer;
+};
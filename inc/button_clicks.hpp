@@ -0,0 +1,62 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <cstdint>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+
+static constexpr auto buttonClicksIface =
+    "xyz.openbmc_project.Chassis.Buttons.Clicks";
+
+/**
+ * @class ButtonClicks
+ *
+ * Sends a Clicked signal on the button object once a gesture of one
+ * or more quick presses is over, e.g. 2 for a double press.  Pressed
+ * still goes out for every press as it happens, Released only for a
+ * single press, right before Clicked(1).
+ */
+class ButtonClicks
+{
+  public:
+    ButtonClicks() = delete;
+    ButtonClicks(const ButtonClicks&) = delete;
+    ButtonClicks& operator=(const ButtonClicks&) = delete;
+    ButtonClicks(ButtonClicks&&) = delete;
+    ButtonClicks& operator=(ButtonClicks&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - sdbusplus connection object
+     * @param[in] path - the button object path
+     */
+    ButtonClicks(sdbusplus::bus::bus& bus, const char* path);
+
+    /**
+     * @brief Sends the Clicked signal
+     *
+     * @param[in] count - the number of clicks of the gesture
+     */
+    void clicked(uint8_t count);
+
+  private:
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    sdbusplus::server::interface::interface clicksIface;
+};
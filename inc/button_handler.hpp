@@ -1,7 +1,19 @@
 #pragma once
 
+#include "button_state.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <optional>
 #include <sdbusplus/bus.hpp>
 #include <sdbusplus/bus/match.hpp>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
 
 namespace phosphor
 {
@@ -16,8 +28,17 @@ namespace button
  * it detects button presses.
  *
  * There are 3 buttons supported - Power, ID, and Reset.
- * As not all systems may implement each button, this class will
- * check for that button on D-Bus before listening for its signals.
+ * A system may have several instances of each, e.g. one power
+ * button per sled.  The number at the end of a button's object
+ * path selects the host and chassis state objects it acts on.
+ *
+ * All method calls are made asynchronously from the sd_event loop the
+ * bus is attached to, so several actions can be in flight at once and
+ * a slow service never holds up the handling of another press.
+ *
+ * The handler normally runs in its own process and matches on the
+ * button signals.  Built with IN_PROCESS_HANDLER it runs inside the
+ * buttons daemon instead, which passes it the actions directly.
  */
 class Handler
 {
@@ -33,19 +54,149 @@ class Handler
      * @brief Constructor
      *
      * @param[in] bus - sdbusplus connection object
+     * @param[in] inProcess - if the buttons pass their actions with
+     *                        buttonAction() instead of the handler
+     *                        matching on their signals
+     */
+    Handler(sdbusplus::bus::bus& bus, bool inProcess = false);
+
+    /**
+     * @brief Acts on the action of a button in the same process, as
+     *        on the signal the button emits for it
+     *
+     * @param[in] type - the button type, e.g. power
+     * @param[in] path - the button object path
+     * @param[in] action - the action
      */
-    Handler(sdbusplus::bus::bus& bus);
+    void buttonAction(const std::string& type, const std::string& path,
+                      ButtonAction action);
 
   private:
+    /**
+     * @brief Called with the reply of a successful method call
+     */
+    using ReplyCallback = std::function<void(sdbusplus::message::message&)>;
+
+    /**
+     * @brief Called with the service found for an object
+     */
+    using ServiceCallback = std::function<void(const std::string&)>;
+
+    /**
+     * @brief Called with the current state of a chassis or host
+     */
+    using StateCallback = std::function<void(const std::string&)>;
+
+    /**
+     * @brief Called when a method call, or the lookup it needed,
+     *        failed or timed out
+     */
+    using FailCallback = std::function<void()>;
+
+    /**
+     * @brief The types of the properties the handler sets
+     */
+    using PropertyValue = std::variant<std::string, bool>;
+
+    /**
+     * @brief A method call waiting for its reply
+     */
+    struct PendingCall
+    {
+        PendingCall(Handler& handler, const std::string& path,
+                    const char* what, ReplyCallback&& callback,
+                    FailCallback&& failed) :
+            handler(handler),
+            path(path), what(what), callback(std::move(callback)),
+            failed(std::move(failed))
+        {
+        }
+        ~PendingCall()
+        {
+            sd_bus_slot_unref(slot);
+        }
+        PendingCall(const PendingCall&) = delete;
+        PendingCall& operator=(const PendingCall&) = delete;
+
+        Handler& handler;
+        std::list<PendingCall>::iterator self;
+        sd_bus_slot* slot = nullptr;
+        std::string path;
+        const char* what;
+        ReplyCallback callback;
+        FailCallback failed;
+    };
+
+    /**
+     * @brief The mirrored and the requested state of an LED group
+     *        the ID button toggles
+     */
+    struct LedGroup
+    {
+        /** @brief Asserted as last seen on D-Bus, if known */
+        std::optional<bool> asserted;
+
+        /** @brief The state still to be written, if any */
+        std::optional<bool> target;
+
+        /** @brief The state a Set in flight is writing, if any */
+        std::optional<bool> inflight;
+    };
+
+    /**
+     * @brief Adds the matches on the signals of every button
+     */
+    void matchButtons();
+
+    /**
+     * @brief Sends a method call without waiting for its reply
+     *
+     * Errors, including the call timing out, are logged with the
+     * description passed in and the failed callback is run instead.
+     *
+     * @param[in] method - the method call
+     * @param[in] timeout - how long to wait for the reply, in us
+     * @param[in] what - a description of the call for the logs
+     * @param[in] callback - run with the reply, may be empty
+     * @param[in] failed - run if the call fails, may be empty
+     */
+    void callAsync(sdbusplus::message::message& method, uint64_t timeout,
+                   const char* what, ReplyCallback&& callback,
+                   FailCallback&& failed = nullptr);
+
+    /**
+     * @brief The sd-bus callback for the replies of callAsync()
+     */
+    static int asyncReply(sd_bus_message* msg, void* userData,
+                          sd_bus_error* retError);
+
+    /**
+     * @brief Sets a property on an object, looking up its service
+     *        first if needed
+     *
+     * @param[in] path - the object path
+     * @param[in] interface - the interface of the property
+     * @param[in] property - the property name
+     * @param[in] value - the new value
+     * @param[in] timeout - how long to wait for the reply, in us
+     * @param[in] what - a description of the call for the logs
+     * @param[in] done - run with true once set, or false if that
+     *                   failed, may be empty
+     */
+    void setProperty(const std::string& path, const std::string& interface,
+                     const std::string& property, const PropertyValue& value,
+                     uint64_t timeout, const char* what,
+                     std::function<void(bool)>&& done = nullptr);
+
     /**
      * @brief The handler for a power button press
      *
      * It will power on the system if it's currently off,
      * else it will soft power it off.
      *
-     * @param[in] msg - sdbusplus message from signal
+     * @param[in] path - the button object path
      */
-    void powerPressed(sdbusplus::message::message& msg);
+    void powerPressed(const std::string& path);
 
     /**
      * @brief The handler for a long power button press
@@ -53,46 +204,148 @@ class Handler
      * If the system is currently powered on, it will
      * perform an immediate power off.
      *
-     * @param[in] msg - sdbusplus message from signal
+     * @param[in] path - the button object path
      */
-    void longPowerPressed(sdbusplus::message::message& msg);
+    void longPowerPressed(const std::string& path);
 
     /**
      * @brief The handler for an ID button press
      *
      * Toggles the ID LED group
      *
-     * @param[in] msg - sdbusplus message from signal
+     * @param[in] path - the button object path
      */
-    void idPressed(sdbusplus::message::message& msg);
+    void idPressed(const std::string& path);
 
     /**
      * @brief The handler for a reset button press
      *
      * Reboots the host if it is powered on.
      *
-     * @param[in] msg - sdbusplus message from signal
+     * @param[in] path - the button object path
      */
-    void resetPressed(sdbusplus::message::message& msg);
+    void resetPressed(const std::string& path);
 
     /**
      * @brief Checks if system is powered on
      *
-     * @return true if powered on, false else
+     * @param[in] instance - the chassis instance number
+     * @param[in] callback - run with true if powered on, false else
      */
-    bool poweredOn() const;
+    void poweredOn(const std::string& instance,
+                   std::function<void(bool)>&& callback);
 
     /**
-     * @brief Returns the service name for an object
+     * @brief Finds the service name for an object
+     *
+     * The result is cached, so only the first lookup of an object
+     * and interface calls the object mapper.  A cached service is
+     * passed to the callback right away.
      *
      * @param[in] path - the object path
      * @param[in] interface - the interface name
+     * @param[in] callback - run with the D-Bus service name if found
+     * @param[in] failed - run if it isn't, may be empty
+     */
+    void getService(const std::string& path, const std::string& interface,
+                    ServiceCallback&& callback,
+                    FailCallback&& failed = nullptr);
+
+    /**
+     * @brief Adds a NameOwnerChanged match for a service the
+     *        handler caches data of, if there isn't one yet
+     *
+     * @param[in] service - the service name
+     */
+    void watchService(const std::string& service);
+
+    /**
+     * @brief Reads the current state of every chassis and host
+     *        state object, so presses don't need to
+     */
+    void loadStates();
+
+    /**
+     * @brief Reads the current state of one chassis or host into
+     *        the local copy
      *
-     * @return std::string - the D-Bus service name if found, else
-     *                       an empty string
+     * @param[in] service - the service owning the object
+     * @param[in] path - the state object path
+     * @param[in] interface - the chassis or host state interface
+     * @param[in] callback - run with the state once read, may be empty
      */
-    std::string getService(const std::string& path,
-                           const std::string& interface) const;
+    void readState(const std::string& service, const std::string& path,
+                   const std::string& interface,
+                   StateCallback&& callback = nullptr);
+
+    /**
+     * @brief Finds the current state of a chassis or host from the
+     *        local copy, reading it first if it isn't known yet
+     *
+     * @param[in] path - the state object path
+     * @param[in] interface - the chassis or host state interface
+     * @param[in] callback - run with the CurrentPowerState or
+     *                       CurrentHostState value
+     */
+    void getCurrentState(const std::string& path,
+                         const std::string& interface,
+                         StateCallback&& callback);
+
+    /**
+     * @brief Toggles all of the ID LED groups
+     *
+     * The new state is the opposite of the latest one requested, or
+     * else being written, or else seen, so presses made while a Set
+     * is in flight coalesce into writing only the final state.
+     */
+    void toggleIdLeds();
+
+    /**
+     * @brief Writes the requested state of an ID LED group, unless
+     *        a Set is already in flight or it's already in that state
+     *
+     * @param[in] path - the LED group object path
+     */
+    void writeLedGroup(const std::string& path);
+
+    /**
+     * @brief Reads the Asserted property of an ID LED group into the
+     *        local copy
+     *
+     * @param[in] path - the LED group object path
+     * @param[in] callback - run once read, may be empty
+     */
+    void readLedGroup(const std::string& path,
+                      std::function<void()>&& callback = nullptr);
+
+    /**
+     * @brief Updates the local copy of an ID LED group's state
+     *
+     * @param[in] msg - the PropertiesChanged signal
+     */
+    void ledGroupChanged(sdbusplus::message::message& msg);
+
+    /**
+     * @brief Updates the local copy of a state
+     *
+     * @param[in] msg - the PropertiesChanged signal
+     */
+    void stateChanged(sdbusplus::message::message& msg);
+
+    /**
+     * @brief Drops the cached lookups that resolved to a service
+     *        whose owner changed, and reloads its states
+     *
+     * @param[in] msg - the NameOwnerChanged signal
+     */
+    void serviceOwnerChanged(sdbusplus::message::message& msg);
+
+    /**
+     * @brief Drops the cached lookups of removed interfaces
+     *
+     * @param[in] msg - the InterfacesRemoved signal
+     */
+    void interfacesRemoved(sdbusplus::message::message& msg);
 
     /**
      * @brief sdbusplus connection object
@@ -100,22 +353,73 @@ class Handler
     sdbusplus::bus::bus& bus;
 
     /**
-     * @brief Matches on the power button released signal
+     * @brief The method calls waiting for their replies
+     */
+    std::list<PendingCall> pendingCalls;
+
+    /**
+     * @brief The services found by getService(), keyed by object
+     *        path and interface
+     */
+    std::map<std::pair<std::string, std::string>, std::string>
+        serviceCache;
+
+    /**
+     * @brief Matches on the NameOwnerChanged signal of every service
+     *        in the cache
+     */
+    std::map<std::string, std::unique_ptr<sdbusplus::bus::match_t>>
+        serviceWatches;
+
+    /**
+     * @brief Matches on InterfacesRemoved signals
+     */
+    sdbusplus::bus::match_t interfacesRemovedMatch;
+
+    /**
+     * @brief The current state of each chassis and host, keyed by
+     *        the state object path
+     */
+    std::map<std::string, std::string> currentStates;
+
+    /**
+     * @brief The service and interface of each state object read,
+     *        kept to reload the states when a service restarts
+     */
+    std::map<std::string, std::pair<std::string, std::string>> stateObjects;
+
+    /**
+     * @brief Matches on the chassis and host PropertiesChanged signals
+     */
+    std::vector<std::unique_ptr<sdbusplus::bus::match_t>> stateChangedMatches;
+
+    /**
+     * @brief The LED groups the ID button toggles, keyed by path
+     */
+    std::map<std::string, LedGroup> idLedGroups;
+
+    /**
+     * @brief Matches on the LED group PropertiesChanged signals
+     */
+    std::unique_ptr<sdbusplus::bus::match_t> ledGroupChangedMatch;
+
+    /**
+     * @brief Matches on the released signal of every power button
      */
     std::unique_ptr<sdbusplus::bus::match_t> powerButtonReleased;
 
     /**
-     * @brief Matches on the power button long press released signal
+     * @brief Matches on the long press signal of every power button
      */
     std::unique_ptr<sdbusplus::bus::match_t> powerButtonLongPressReleased;
 
     /**
-     * @brief Matches on the ID button released signal
+     * @brief Matches on the released signal of every ID button
      */
     std::unique_ptr<sdbusplus::bus::match_t> idButtonReleased;
 
     /**
-     * @brief Matches on the reset button released signal
+     * @brief Matches on the released signal of every reset button
      */
     std::unique_ptr<sdbusplus::bus::match_t> resetButtonReleased;
 };
@@ -0,0 +1,62 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <cstdint>
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+
+static constexpr auto buttonHoldIface =
+    "xyz.openbmc_project.Chassis.Buttons.Hold";
+
+/**
+ * @class ButtonHold
+ *
+ * Sends a Held signal on the button object each time a press that
+ * is still going on reaches one of the button's hold tiers, so an
+ * action can be tied to holding the button for e.g. 15 seconds.
+ */
+class ButtonHold
+{
+  public:
+    ButtonHold() = delete;
+    ButtonHold(const ButtonHold&) = delete;
+    ButtonHold& operator=(const ButtonHold&) = delete;
+    ButtonHold(ButtonHold&&) = delete;
+    ButtonHold& operator=(ButtonHold&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - sdbusplus connection object
+     * @param[in] path - the button object path
+     */
+    ButtonHold(sdbusplus::bus::bus& bus, const char* path);
+
+    /**
+     * @brief Sends the Held signal
+     *
+     * @param[in] tier - the tier reached, starting at 1
+     * @param[in] holdMs - how long the button was held for it
+     */
+    void held(uint8_t tier, uint32_t holdMs);
+
+  private:
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    sdbusplus::server::interface::interface holdIface;
+};
@@ -0,0 +1,219 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "button_state.hpp"
+#include "gpio.hpp"
+
+#include <cstdint>
+#include <optional>
+
+/**
+ * @class ButtonMachine
+ *
+ * Runs the edges of a button line through the debounce stage, the
+ * state machine, the click counter and the signal rate limiter, and
+ * the timers of all of them, on the clock of the edges.  It has no
+ * D-Bus or event loop side: ButtonBase drives it from the loop and
+ * button-replay from a trace, so a replay reports what the daemon
+ * did.
+ *
+ * Every edge first runs the timers due by its timestamp, so a press
+ * is classified from the times of its edges and not from how late
+ * the loop got to them.  A hold deadline passing while a burst of
+ * edges that started before it is still being debounced waits for the
+ * burst to settle, which keeps a release that started before the
+ * deadline a short press.
+ *
+ * With a click window, the releases of the clicks are held back
+ * until the gesture is over: a single click is then sent as the
+ * release and Clicked(1), a multi-click only as Clicked(n), so what
+ * acts on Released sees one release per gesture.
+ *
+ * The results are passed to the virtual functions, which a driver
+ * overrides to emit them.
+ */
+class ButtonMachine
+{
+  public:
+    ButtonMachine() = delete;
+    ButtonMachine(const ButtonMachine&) = delete;
+    ButtonMachine& operator=(const ButtonMachine&) = delete;
+    ButtonMachine(ButtonMachine&&) = delete;
+    ButtonMachine& operator=(ButtonMachine&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] policy - the button policy
+     */
+    explicit ButtonMachine(const ButtonPolicy& policy) : policy(policy)
+    {
+    }
+
+    virtual ~ButtonMachine() = default;
+
+    /**
+     * @brief Processes an edge read from the line, after running the
+     *        timers due by its timestamp
+     *
+     * @param[in] event - the edge
+     *
+     * @return the number of edges found lost before it
+     */
+    uint64_t edge(const GpioEvent& event);
+
+    /**
+     * @brief When the next timer is due
+     *
+     * @return the CLOCK_MONOTONIC time in nanoseconds, or nothing if
+     *         no timer is armed
+     */
+    std::optional<uint64_t> nextDeadline() const;
+
+    /**
+     * @brief Runs the timers due by a time, in the order they are due
+     *
+     * @param[in] now - the CLOCK_MONOTONIC time in nanoseconds
+     */
+    void expire(uint64_t now);
+
+    const ButtonPolicy& buttonPolicy() const
+    {
+        return policy;
+    }
+
+    const ButtonState& buttonState() const
+    {
+        return state;
+    }
+
+  protected:
+    /**
+     * @brief Sends an action the rate limiter let through
+     *
+     * @param[in] action - the action, never ButtonAction::none
+     * @param[in] heldBack - whether the rate limiter held it back
+     *                       for a while
+     */
+    virtual void send(ButtonAction action, bool heldBack) = 0;
+
+    /**
+     * @brief Reports the hold tier the current press just reached
+     *
+     * @param[in] tier - the tier, from 1
+     */
+    virtual void held(uint8_t tier) = 0;
+
+    /**
+     * @brief Reports a gesture that is over
+     *
+     * @param[in] count - the clicks of the gesture
+     */
+    virtual void clicked(uint8_t count) = 0;
+
+    /**
+     * @brief Called with every action an edge results in, whether it
+     *        is sent or not
+     *
+     * @param[in] action - the action
+     * @param[in] event - the edge that passed the debounce stage
+     * @param[in] sent - whether it was sent right away
+     */
+    virtual void classified(ButtonAction action, const GpioEvent& event,
+                            bool sent)
+    {
+    }
+
+    /**
+     * @brief Passes a press or release to the chords
+     *
+     * @param[in] pressed - whether the button is now pressed
+     * @param[in] timestamp - CLOCK_MONOTONIC time of the edge in ns
+     *
+     * @return whether the button is engaged in a chord
+     */
+    virtual bool chordLevel(bool pressed, uint64_t timestamp)
+    {
+        return false;
+    }
+
+    /**
+     * @brief Whether the button is engaged in a chord, which holds
+     *        back its own signals, see ChordTracker
+     */
+    virtual bool chordEngaged() const
+    {
+        return false;
+    }
+
+    /**
+     * @brief The time the machine has got to, that of the last edge or
+     *        timer run, in nanoseconds
+     */
+    uint64_t clockNow() const
+    {
+        return clock;
+    }
+
+    ButtonPolicy policy;
+    ButtonState state;
+
+  private:
+    enum class Timeout
+    {
+        none,
+        debounce,
+        rateLimit,
+        hold,
+        click
+    };
+
+    /**
+     * @brief The timer due next
+     *
+     * @param[out] deadline - when it is due
+     */
+    Timeout nextTimeout(uint64_t& deadline) const;
+
+    /**
+     * @brief Passes an edge through the debounce stage to handleEdge
+     */
+    void feedEdge(const GpioEvent& event);
+
+    /**
+     * @brief Runs an edge that passed the debounce stage through the
+     *        state machine and sends the result
+     */
+    void handleEdge(const GpioEvent& event);
+
+    /**
+     * @brief Passes an action through the rate limiter and sends it
+     *
+     * @return true if it was sent right away
+     */
+    bool signal(ButtonAction action);
+
+    /**
+     * @brief Reports a gesture that is over, after the release held
+     *        back if it was a single click
+     *
+     * @param[in] count - the clicks of the gesture
+     */
+    void gestureOver(uint8_t count);
+
+    uint64_t clock = 0;
+};
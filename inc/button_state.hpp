@@ -0,0 +1,361 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+
+#include "gpio.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+/**
+ * @brief What a button edge means for the D-Bus object
+ */
+enum class ButtonAction : uint8_t
+{
+    none,
+    pressed,
+    released,
+    pressedLong
+};
+
+/**
+ * @brief The most hold thresholds a button can have
+ */
+constexpr size_t maxHoldTiers = 4;
+
+/**
+ * @brief Per button behavior, fixed when the button is created
+ */
+struct ButtonPolicy
+{
+    // How many nanoseconds the button must be held down to reach
+    // each hold tier, in ascending order.  Reaching the first one
+    // is a long press.
+    std::array<uint64_t, maxHoldTiers> holdTimes{};
+    // How many of holdTimes are used, 0 disables long presses
+    uint8_t holdTiers = 0;
+    // Whether reaching the first hold tier is a long press.  If not,
+    // the tiers only report Held and the release is still signaled.
+    bool longPress = true;
+    // The line must be stable for this many nanoseconds before a
+    // transition is accepted, 0 disables debouncing
+    uint64_t debounceTime = 0;
+    // Nanoseconds between signals at the sustained signal rate,
+    // 0 disables rate limiting
+    uint64_t signalInterval = 0;
+    // How many signals may be sent back to back before the rate
+    // limit applies
+    uint32_t signalBurst = 1;
+    // How many nanoseconds after a click the next one may start and
+    // still be part of the same gesture, 0 disables click counting
+    uint64_t clickWindow = 0;
+};
+
+/**
+ * @brief What a button knows of the edges read from its line, to
+ *        tell when some were lost
+ */
+struct EdgeTrackState
+{
+    // The level after the last edge read, lines idle high
+    uint8_t level = 1;
+    // Whether an edge was read yet
+    bool seen = false;
+    // The sequence number of the last edge, 0 if the backend has none
+    uint32_t seqno = 0;
+};
+
+/**
+ * @brief The debounce stage state of a button
+ */
+struct DebounceState
+{
+    // The edge that started the current burst, with the latest level
+    GpioEvent pendingEdge{};
+    // When the burst settles if no more edges arrive
+    uint64_t deadline = 0;
+    // The last accepted level, lines idle high
+    uint8_t stableValue = 1;
+    bool pending = false;
+    // Edges that were dropped as bounces
+    uint64_t filteredEdges = 0;
+};
+
+/**
+ * @brief The signal rate limiter state of a button
+ *
+ * The limiter is a token bucket kept as the time the bucket will
+ * be full again, so taking a token and refilling are O(1).
+ */
+struct RateLimitState
+{
+    // When the next signal conforms to the sustained rate
+    uint64_t nextTime = 0;
+    // The latest action held back by the limiter
+    ButtonAction pending = ButtonAction::none;
+    // Whether the last signal sent said the button is pressed
+    bool emittedPressed = false;
+    // Actions that were never signaled
+    uint64_t droppedEdges = 0;
+};
+
+/**
+ * @brief The number of buckets in a latency histogram
+ */
+constexpr size_t latencyBuckets = 16;
+
+/**
+ * @brief A fixed size histogram of the time from an edge to its
+ *        signal, updated in place so recording never allocates
+ *
+ * Bucket i counts the latencies below latencyBound(i); the buckets
+ * double in width from 64us, and the last one has no upper bound.
+ */
+struct LatencyHistogram
+{
+    std::array<uint64_t, latencyBuckets> counts{};
+};
+
+/**
+ * @brief Counters on the activity of a button
+ */
+struct ButtonCounters
+{
+    // Edges read from the GPIO line, including bounces
+    uint64_t edges = 0;
+    // Presses and long presses seen by the state machine
+    uint64_t presses = 0;
+    uint64_t longPresses = 0;
+    // Failed reads of the GPIO line
+    uint64_t readErrors = 0;
+    // Edges known to be missing from what was read
+    uint64_t lostEdges = 0;
+    LatencyHistogram latency;
+};
+
+/**
+ * @brief The click counter of a button
+ */
+struct ClickState
+{
+    // The clicks of the current gesture
+    uint8_t count = 0;
+    // CLOCK_MONOTONIC time the gesture ends at unless the button is
+    // pressed again, in nanoseconds
+    uint64_t deadline = 0;
+};
+
+/**
+ * @brief The state a button keeps between edges
+ */
+struct ButtonState
+{
+    // CLOCK_MONOTONIC time of the last press edge, in nanoseconds
+    uint64_t pressedTime = 0;
+    bool pressed = false;
+    // The hold tiers reached by the current press
+    uint8_t holdTier = 0;
+    EdgeTrackState track;
+    ClickState click;
+    DebounceState debounce;
+    RateLimitState rateLimit;
+    ButtonCounters counters;
+};
+
+/**
+ * @brief The upper bound of a latency histogram bucket
+ *
+ * @param[in] bucket - the bucket index
+ *
+ * @return the bound in microseconds, UINT64_MAX for the last bucket
+ */
+uint64_t latencyBound(size_t bucket);
+
+/**
+ * @brief Adds a latency to a histogram
+ *
+ * @param[in,out] histogram - the histogram
+ * @param[in] latency - the latency in nanoseconds
+ */
+void recordLatency(LatencyHistogram& histogram, uint64_t latency);
+
+/**
+ * @brief Counts the clicks of a multi-click gesture
+ *
+ * Called after processEdge() for every press and release.  A click is
+ * a press released before its first hold tier, a long press ends the
+ * gesture of the clicks before it.
+ *
+ * @param[in,out] state - the button state
+ * @param[in] policy - the button policy
+ * @param[in] timestamp - CLOCK_MONOTONIC time of the edge in ns
+ *
+ * @return the clicks of a gesture a press found already over, as the
+ *         click timer hadn't run yet, or a long press ended, else 0
+ */
+uint8_t clickEdge(ButtonState& state, const ButtonPolicy& policy,
+                  uint64_t timestamp);
+
+/**
+ * @brief When the current gesture ends unless the button is pressed
+ *        again
+ *
+ * @param[in] state - the button state
+ *
+ * @return the CLOCK_MONOTONIC time in nanoseconds, or nothing if there
+ *         is no gesture or the button is down
+ */
+std::optional<uint64_t> clickDeadline(const ButtonState& state);
+
+/**
+ * @brief Ends the current gesture once its window is over
+ *
+ * @param[in,out] state - the button state
+ * @param[in] now - the current CLOCK_MONOTONIC time in nanoseconds
+ *
+ * @return the clicks of the gesture ended, or 0
+ */
+uint8_t clickExpired(ButtonState& state, uint64_t now);
+
+/**
+ * @brief Checks an edge read from the line for edges lost before it
+ *
+ * With the cdev backend a gap in the sequence numbers counts the
+ * lost edges.  With sysfs two quick edges can merge into one wakeup
+ * that reads the level the line already had.  Either way, an edge
+ * to the level the line is already at means the opposite transition
+ * was missed, and it is reconstructed so the state machine sees the
+ * line alternate.  Its timestamp is that of the edge read, as when
+ * it happened isn't known, so a reconstructed press is never long.
+ *
+ * @param[in,out] state - the button state
+ * @param[in] event - the edge read
+ *
+ * @return the missed edge to process before event, if any
+ */
+std::optional<GpioEvent> trackEdge(ButtonState& state, const GpioEvent& event);
+
+/**
+ * @brief Feeds an edge to the debounce stage
+ *
+ * Without a debounce time the edge is passed straight through.
+ * Otherwise it starts or extends a burst and nothing is returned;
+ * debounceSettle() must then be called once state.deadline passes.
+ *
+ * @param[in,out] state - the debounce state
+ * @param[in] policy - the button policy
+ * @param[in] event - the edge
+ *
+ * @return the edge to process now, if any
+ */
+std::optional<GpioEvent> debounceEdge(DebounceState& state,
+                                      const ButtonPolicy& policy,
+                                      const GpioEvent& event);
+
+/**
+ * @brief Ends a burst once the line has been stable long enough
+ *
+ * @param[in,out] state - the debounce state
+ * @param[in] now - the current CLOCK_MONOTONIC time in nanoseconds
+ *
+ * @return the stable transition, stamped with the time of the first
+ *         edge of the burst, or nothing if the burst is still going
+ *         or the line went back to its previous level
+ */
+std::optional<GpioEvent> debounceSettle(DebounceState& state, uint64_t now);
+
+/**
+ * @brief Runs one edge through the button state machine
+ *
+ * The lines are active low, so a level of 0 is a press.  This is
+ * the whole per edge path shared by every button type and does not
+ * touch D-Bus or the GPIO line.
+ *
+ * A release after a long press returns nothing, the long press was
+ * its signal.  Without policy.longPress every release is reported.
+ *
+ * @param[in,out] state - the button state
+ * @param[in] policy - the button policy
+ * @param[in] event - the edge
+ *
+ * @return the action to report for the edge
+ */
+ButtonAction processEdge(ButtonState& state, const ButtonPolicy& policy,
+                         const GpioEvent& event);
+
+/**
+ * @brief When the current press reaches its next hold tier
+ *
+ * @param[in] state - the button state
+ * @param[in] policy - the button policy
+ *
+ * @return the CLOCK_MONOTONIC time in nanoseconds, or nothing if the
+ *         button is released or has reached its last tier
+ */
+std::optional<uint64_t> holdDeadline(const ButtonState& state,
+                                     const ButtonPolicy& policy);
+
+/**
+ * @brief Moves the current press on to its next hold tier once the
+ *        button has been held down long enough
+ *
+ * @param[in,out] state - the button state
+ * @param[in] policy - the button policy
+ * @param[in] now - the current CLOCK_MONOTONIC time in nanoseconds
+ *
+ * @return true if state.holdTier was advanced
+ */
+bool holdExpired(ButtonState& state, const ButtonPolicy& policy,
+                 uint64_t now);
+
+/**
+ * @brief Passes an action through the signal rate limiter
+ *
+ * If the action is over the limit it is held back as pending,
+ * replacing any earlier pending action, and rateLimitFlush() must
+ * be called once rateLimitDeadline() passes.
+ *
+ * @param[in,out] state - the rate limiter state
+ * @param[in] policy - the button policy
+ * @param[in] action - the action to signal
+ * @param[in] now - the current CLOCK_MONOTONIC time in nanoseconds
+ *
+ * @return the action to signal now, or ButtonAction::none
+ */
+ButtonAction rateLimitAction(RateLimitState& state, const ButtonPolicy& policy,
+                             ButtonAction action, uint64_t now);
+
+/**
+ * @brief Collapses the actions held back during a burst into one
+ *
+ * @param[in,out] state - the rate limiter state
+ * @param[in] policy - the button policy
+ * @param[in] now - the current CLOCK_MONOTONIC time in nanoseconds
+ *
+ * @return the pending action if it changes the pressed state last
+ *         signaled, else ButtonAction::none
+ */
+ButtonAction rateLimitFlush(RateLimitState& state, const ButtonPolicy& policy,
+                            uint64_t now);
+
+/**
+ * @brief When a pending action may be flushed
+ */
+uint64_t rateLimitDeadline(const RateLimitState& state,
+                           const ButtonPolicy& policy);
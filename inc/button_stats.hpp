@@ -0,0 +1,92 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "button_state.hpp"
+
+#include <sdbusplus/bus.hpp>
+#include <sdbusplus/server/interface.hpp>
+#include <sdbusplus/vtable.hpp>
+
+static constexpr auto buttonStatsIface =
+    "xyz.openbmc_project.Chassis.Buttons.Statistics";
+
+/**
+ * @class ButtonStatistics
+ *
+ * Publishes the counters a button keeps in its ButtonState as read
+ * only properties on the button object.  The values are read when a
+ * client asks for them, so the edge path never touches D-Bus for
+ * them and no PropertiesChanged signals are sent.
+ *
+ * SignalLatency is the histogram of the time from an edge to its
+ * signal being sent, with the upper bound of each bucket given in
+ * microseconds by SignalLatencyBounds.  With the sysfs backend edges
+ * are timestamped when read, so the time the event loop took to
+ * wake up isn't included.
+ */
+class ButtonStatistics
+{
+  public:
+    ButtonStatistics() = delete;
+    ButtonStatistics(const ButtonStatistics&) = delete;
+    ButtonStatistics& operator=(const ButtonStatistics&) = delete;
+    ButtonStatistics(ButtonStatistics&&) = delete;
+    ButtonStatistics& operator=(ButtonStatistics&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] bus - sdbusplus connection object
+     * @param[in] path - the button object path
+     * @param[in] state - the button state holding the counters
+     */
+    ButtonStatistics(sdbusplus::bus::bus& bus, const char* path,
+                     const ButtonState& state);
+
+  private:
+    static int getFilteredEdges(sd_bus* bus, const char* path,
+                                const char* interface, const char* property,
+                                sd_bus_message* reply, void* context,
+                                sd_bus_error* error);
+
+    static int getDroppedEdges(sd_bus* bus, const char* path,
+                               const char* interface, const char* property,
+                               sd_bus_message* reply, void* context,
+                               sd_bus_error* error);
+
+    template <uint64_t ButtonCounters::*counter>
+    static int getCounter(sd_bus* bus, const char* path,
+                          const char* interface, const char* property,
+                          sd_bus_message* reply, void* context,
+                          sd_bus_error* error);
+
+    static int getSignalLatency(sd_bus* bus, const char* path,
+                                const char* interface, const char* property,
+                                sd_bus_message* reply, void* context,
+                                sd_bus_error* error);
+
+    static int getSignalLatencyBounds(sd_bus* bus, const char* path,
+                                      const char* interface,
+                                      const char* property,
+                                      sd_bus_message* reply, void* context,
+                                      sd_bus_error* error);
+
+    static const sdbusplus::vtable::vtable_t vtable[];
+
+    const ButtonState& state;
+    sdbusplus::server::interface::interface statsIface;
+};
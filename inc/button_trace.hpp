@@ -0,0 +1,200 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "button_state.hpp"
+#include "chord_tracker.hpp"
+#include "gpio.hpp"
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+/**
+ * A trace file records the edges read from every button line, so a
+ * press can be replayed through the button state machine later.
+ *
+ * It starts with a TraceHeader followed by TraceRecords, all in host
+ * byte order.  A line record is followed by the TraceLine describing
+ * the line, edge records refer to it by its index.  A chord record is
+ * followed by a TraceChord, from version 3 on.
+ */
+static constexpr std::array<char, 8> traceMagic = {'B', 'T', 'N', 'T',
+                                                   'R', 'A', 'C', 'E'};
+static constexpr uint32_t traceVersion = 3;
+
+struct TraceHeader
+{
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t reserved;
+};
+
+enum class TraceRecordType : uint8_t
+{
+    edge,
+    line,
+    chord
+};
+
+struct TraceRecord
+{
+    // CLOCK_MONOTONIC time of the edge in nanoseconds
+    uint64_t timestamp;
+    uint32_t seqno;
+    // The index of the line, in the order the lines were added
+    uint16_t line;
+    TraceRecordType type;
+    uint8_t value;
+};
+
+/**
+ * @brief A traced line, with the policy its button had so a replay
+ *        doesn't depend on the configuration at the time
+ */
+struct TraceLine
+{
+    std::array<char, 32> name;
+    uint64_t debounceTime;
+    uint64_t signalInterval;
+    std::array<uint64_t, maxHoldTiers> holdTimes;
+    uint32_t signalBurst;
+    uint8_t holdTiers;
+    // 1 if the hold tiers only report Held, see ButtonPolicy::longPress
+    uint8_t holdOnly;
+    // The click window in milliseconds, reserved and so 0 in version 1
+    uint16_t clickMs;
+
+    /**
+     * @brief The button policy the line was recorded with
+     */
+    ButtonPolicy policy() const;
+};
+
+/**
+ * @brief A chord of the traced lines
+ */
+struct TraceChord
+{
+    std::array<char, 32> name;
+    uint32_t holdMs;
+    uint32_t reserved;
+    // The GPIO names of its buttons, the unused ones empty
+    std::array<std::array<char, 32>, ChordTracker::maxChordButtons> gpios;
+
+    /**
+     * @brief The chord definition the chord was recorded from
+     */
+    ChordDefinition definition() const;
+};
+
+/**
+ * @class TraceWriter
+ *
+ * Appends the edges of the button lines to a trace file.  Every
+ * batch of edges is written with a single write(), so the file is
+ * complete up to the last wakeup if the daemon goes away.
+ */
+class TraceWriter
+{
+  public:
+    TraceWriter() = delete;
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+    TraceWriter(TraceWriter&&) = delete;
+    TraceWriter& operator=(TraceWriter&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] path - the trace file, truncated if it exists
+     *
+     * @throw std::runtime_error if the file can't be written
+     */
+    explicit TraceWriter(const std::string& path);
+
+    ~TraceWriter();
+
+    /**
+     * @brief Adds a line to the trace
+     *
+     * @param[in] name - the GPIO name
+     * @param[in] policy - the policy of its button
+     *
+     * @return the index the edges of the line are recorded with
+     */
+    uint16_t addLine(const std::string& name, const ButtonPolicy& policy);
+
+    /**
+     * @brief Adds a chord to the trace, so a replay finds it too
+     *
+     * Chords of more buttons than ChordTracker takes are left out.
+     *
+     * @param[in] chord - the chord definition
+     */
+    void addChord(const ChordDefinition& chord);
+
+    /**
+     * @brief Records a batch of edges read from a line
+     *
+     * @param[in] line - the line index from addLine()
+     * @param[in] events - the edges
+     * @param[in] count - the number of edges
+     *
+     * @return false if the trace could not be written, recording
+     *         then stops
+     */
+    bool edges(uint16_t line, const GpioEvent* events, size_t count);
+
+  private:
+    bool write(const void* data, size_t size);
+
+    int fd = -1;
+    uint16_t lines = 0;
+};
+
+/**
+ * @class TraceReader
+ *
+ * Reads a trace file back one record at a time.
+ */
+class TraceReader
+{
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] path - the trace file
+     *
+     * @throw std::runtime_error if it can't be read or isn't a trace
+     */
+    explicit TraceReader(const std::string& path);
+
+    /**
+     * @brief Reads the next record
+     *
+     * @param[out] record - the record
+     * @param[out] line - filled in for line records
+     * @param[out] chord - filled in for chord records
+     *
+     * @return false at the end of the trace
+     */
+    bool next(TraceRecord& record, TraceLine& line, TraceChord& chord);
+
+  private:
+    std::ifstream stream;
+};
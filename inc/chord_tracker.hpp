@@ -0,0 +1,148 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "gpio.hpp"
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * @class ChordTracker
+ *
+ * Finds the chords of gpio_defs.json, e.g. power and reset held
+ * together for 5 seconds, in the levels of their buttons.  It has no
+ * D-Bus or event loop side, so ButtonChords in the daemon and the
+ * replay of a trace find the same chords.
+ *
+ * Each button that is part of a chord has a bit in one mask of the
+ * levels of all of them, which the buttons update on every debounced
+ * press and release.  The chords are indexed by their mask, so finding
+ * the one the buttons now held form is a single lookup however many
+ * chords there are.
+ *
+ * Once two or more buttons that a chord is made of are down together,
+ * they are engaged in it until each is released: they send none of
+ * their own signals, so e.g. power and reset held for a 5 second chord
+ * don't also send a PressedLong at 3 seconds and a Released.  Only a
+ * Pressed sent before the second button went down is let through, and
+ * a button pressed for longer than its hold times before the chord is
+ * formed has already sent those signals.
+ */
+class ChordTracker
+{
+  public:
+    /**
+     * @brief The most buttons the chords can be made of, one per bit
+     */
+    static constexpr size_t maxButtons = 64;
+
+    /**
+     * @brief The most buttons a single chord can be made of
+     */
+    static constexpr size_t maxChordButtons = 8;
+
+    /**
+     * @brief A chord held long enough
+     */
+    struct Press
+    {
+        const std::string* name;
+        // How long its buttons were held together, in nanoseconds
+        uint64_t heldTime;
+    };
+
+    /**
+     * @brief Adds a chord
+     *
+     * @param[in] def - the chord definition
+     *
+     * @return false if the chord has no buttons, too many, or the same
+     *         ones as an earlier chord, it is then skipped
+     */
+    bool add(const ChordDefinition& def);
+
+    /**
+     * @brief The bit of a button in the level mask
+     *
+     * @param[in] gpioName - the GPIO name of the button
+     *
+     * @return the bit, or std::nullopt if the button is in no chord
+     */
+    std::optional<uint8_t> bit(const std::string& gpioName) const;
+
+    /**
+     * @brief Updates the level of a button
+     *
+     * @param[in] bit - the bit of the button
+     * @param[in] pressed - whether the button is now pressed
+     * @param[in] timestamp - CLOCK_MONOTONIC time of the edge in ns
+     *
+     * @return whether the button is engaged in a chord, in which case
+     *         the edge sends no signal of the button
+     */
+    bool level(uint8_t bit, bool pressed, uint64_t timestamp);
+
+    /**
+     * @brief Whether a button is engaged in a chord, and so sends no
+     *        signal of its own
+     *
+     * @param[in] bit - the bit of the button
+     */
+    bool engaged(uint8_t bit) const
+    {
+        return (engagedMask >> bit) & 1;
+    }
+
+    /**
+     * @brief When the chord the pressed buttons form is held long
+     *        enough, if they form one
+     */
+    std::optional<uint64_t> deadline() const;
+
+    /**
+     * @brief Takes the chord held once it is held long enough, a chord
+     *        is pressed once per press of it
+     *
+     * @param[in] now - the CLOCK_MONOTONIC time in nanoseconds
+     *
+     * @return the chord, or std::nullopt if none is pressed by then
+     */
+    std::optional<Press> pressed(uint64_t now);
+
+  private:
+    struct Chord
+    {
+        std::string name;
+        uint64_t holdTime;
+    };
+
+    std::unordered_map<std::string, uint8_t> bits;
+    std::unordered_map<uint64_t, Chord> chords;
+    // Every set of two or more buttons that is part of a chord
+    std::unordered_set<uint64_t> forming;
+    // The buttons currently pressed, one bit each
+    uint64_t levels = 0;
+    // The buttons engaged in a chord, until each is released
+    uint64_t engagedMask = 0;
+    // The chord the pressed buttons form, if any
+    const Chord* held = nullptr;
+    // When the buttons of the held chord were all down
+    uint64_t heldSince = 0;
+};
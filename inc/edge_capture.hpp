@@ -0,0 +1,174 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "common.hpp"
+#include "gpio.hpp"
+
+#include <pthread.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+
+class ButtonBase;
+
+/**
+ * @brief How the capture thread is scheduled
+ */
+struct CaptureConfig
+{
+    // SCHED_FIFO priority, 0 to keep the default scheduling
+    int priority = 0;
+    // The CPU to pin the thread to, -1 for any
+    int cpu = -1;
+};
+
+/**
+ * @class EdgeCapture
+ *
+ * A thread that does nothing but wait on the GPIO lines and read their
+ * edges, so a burst of D-Bus traffic on the event loop can't delay
+ * them.  The edges are timestamped by the read and passed to the loop
+ * through a bounded single producer, single consumer ring, with an
+ * eventfd to wake it up.  The loop then runs them through the buttons
+ * as if it had read them itself.
+ *
+ * If the loop falls so far behind that the ring fills up, the edges
+ * that don't fit are dropped and counted, and the buttons reconstruct
+ * them as lost edges.
+ */
+class EdgeCapture
+{
+  public:
+    EdgeCapture() = delete;
+    EdgeCapture(const EdgeCapture&) = delete;
+    EdgeCapture& operator=(const EdgeCapture&) = delete;
+    EdgeCapture(EdgeCapture&&) = delete;
+    EdgeCapture& operator=(EdgeCapture&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] event - the sd_event loop the edges are passed to
+     * @param[in] config - the scheduling of the thread
+     *
+     * @throw std::runtime_error if the eventfds or the epoll instance
+     *        can't be created, or the ring can't be added to the loop
+     */
+    EdgeCapture(EventPtr& event, const CaptureConfig& config);
+
+    /**
+     * @brief Stops the thread
+     */
+    ~EdgeCapture();
+
+    /**
+     * @brief Locks the process memory and starts the thread, which
+     *        reads no lines until they are added
+     *
+     * The thread gets a small stack of its own, so locking it doesn't
+     * pin the default thread stack size in memory.
+     *
+     * @throw std::system_error if the thread can't be started
+     */
+    void start();
+
+    /**
+     * @brief Adds a line to read, after start()
+     *
+     * Called by ButtonBase::captureWith().
+     *
+     * @param[in] button - the button the edges are passed to
+     * @param[in] line - the line of the button
+     *
+     * @return false if the thread can't watch the line
+     */
+    bool add(ButtonBase& button, GpioLine& line);
+
+  private:
+    /**
+     * @brief An edge, or a failed read, on its way to the loop
+     */
+    struct Capture
+    {
+        ButtonBase* button;
+        GpioEvent event;
+        // The errno of a failed read, 0 for an edge
+        int error;
+    };
+
+    struct Line
+    {
+        ButtonBase* button;
+        GpioLine* line;
+        // Failed reads in a row, only used by the thread
+        unsigned failedReads;
+    };
+
+    static constexpr size_t ringSize = 256;
+
+    // Ample for run() and the logging it does
+    static constexpr size_t stackSize = 64 * 1024;
+
+    /**
+     * @brief The thread: waits on the lines and fills the ring
+     */
+    void run();
+
+    /**
+     * @brief The start routine of the thread, runs run()
+     */
+    static void* threadMain(void* capture);
+
+    /**
+     * @brief Applies the scheduling config to the calling thread
+     */
+    void schedule() const;
+
+    /**
+     * @brief Queues a capture for the loop, if there is room
+     *
+     * @return false if the ring was full
+     */
+    bool push(const Capture& capture);
+
+    /**
+     * @brief Called on the loop when the eventfd is signaled, passes
+     *        the queued edges to their buttons
+     */
+    static int drain(sd_event_source* es, int fd, uint32_t revents,
+                     void* userdata);
+
+    CaptureConfig config;
+    // Read by the thread through the epoll data, so they must not move
+    std::list<Line> lines;
+    std::array<Capture, ringSize> ring;
+    // Written by the thread only
+    std::atomic<uint64_t> head{0};
+    // Written by the loop only
+    std::atomic<uint64_t> tail{0};
+    // Edges dropped because the ring was full
+    std::atomic<uint64_t> overflows{0};
+    uint64_t overflowsLogged = 0;
+    int wakeFd = -1;
+    int stopFd = -1;
+    int epollFd = -1;
+    sd_event_source* source = nullptr;
+    pthread_t thread;
+    bool started = false;
+};
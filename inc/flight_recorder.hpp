@@ -0,0 +1,86 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class FlightRecorder
+ *
+ * A fixed size ring of the most recent button events, kept in memory
+ * instead of logging every edge to the journal.  Recording is a few
+ * stores with no locking, allocation or system call, and the ring is
+ * only written out when dump() is called, e.g. on SIGUSR1.
+ *
+ * There must be a single writer.  A dump may run concurrently with
+ * it, in which case the oldest entries it prints may be overwritten.
+ */
+class FlightRecorder
+{
+  public:
+    enum class Kind : uint8_t
+    {
+        edge,
+        action,
+        held,
+        readError,
+        lostEdge,
+        clicked
+    };
+
+    struct Entry
+    {
+        // CLOCK_MONOTONIC time in nanoseconds
+        uint64_t timestamp;
+        // The GPIO name of the button, which outlives the entry
+        const char* source;
+        // The edge sequence number, the errno of a read error or the
+        // number of edges lost
+        uint32_t detail;
+        Kind kind;
+        // The line level, ButtonAction, hold tier or click count
+        uint8_t value;
+    };
+
+    static constexpr size_t capacity = 1024;
+
+    /**
+     * @brief Adds an entry, overwriting the oldest one if full
+     */
+    void record(const Entry& entry)
+    {
+        auto head = next.load(std::memory_order_relaxed);
+        entries[head % capacity] = entry;
+        next.store(head + 1, std::memory_order_release);
+    }
+
+    /**
+     * @brief Writes the entries to the journal, oldest first
+     */
+    void dump() const;
+
+  private:
+    std::array<Entry, capacity> entries{};
+    std::atomic<uint64_t> next{0};
+};
+
+/**
+ * @brief The flight recorder shared by every button of the process
+ */
+FlightRecorder& flightRecorder();
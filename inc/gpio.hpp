@@ -15,14 +15,327 @@
 */
 #pragma once
 
-#include <sdbusplus/bus.hpp>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
-int configGpio(const char* gpioName, int* fd, sdbusplus::bus::bus& bus);
-void closeGpio(int fd);
-bool gpioDefined(const std::string& gpioName);
+static constexpr auto gpioDefsFile = "/etc/default/obmc/gpio/gpio_defs.json";
+static constexpr auto gpioSysfsRoot = "/sys/class/gpio";
+static constexpr auto gpioCdevRoot = "/dev";
+
+/**
+ * @brief The maximum number of edge events handed out per read
+ */
+static constexpr size_t maxGpioEvents = 16;
+
+/**
+ * @brief How many reads of a line in a row may fail before it is
+ *        given up on
+ *
+ * sysfs value files always poll with EPOLLERR, so that alone doesn't
+ * tell a transient error from a line that has gone away.
+ */
+static constexpr unsigned maxFailedReads = 10;
+
+/**
+ * @brief The kernel interface used to access GPIO lines
+ *
+ * sysfs uses the deprecated /sys/class/gpio export interface,
+ * cdev uses GPIO v2 line requests on /dev/gpiochipN.
+ */
+enum class GpioBackend
+{
+    sysfs,
+    cdev
+};
+
+/**
+ * @brief Converts a backend name from the config file or build
+ *        options to a GpioBackend
+ *
+ * @param[in] name - "sysfs" or "cdev"
+ *
+ * @return the backend, or std::nullopt if the name is unknown
+ */
+std::optional<GpioBackend> toGpioBackend(const std::string& name);
+
+/**
+ * @brief One edge seen on a GPIO line
+ */
+struct GpioEvent
+{
+    // CLOCK_MONOTONIC time of the edge in nanoseconds
+    uint64_t timestamp;
+    // Per line sequence number, or 0 if the backend has none
+    uint32_t seqno;
+    // Line level after the edge
+    uint8_t value;
+};
+
+/**
+ * @brief One entry of the gpio_definitions array in gpio_defs.json
+ *
+ * The line is either given as an ASPEED style 'pin' name, or as a
+ * numeric 'offset' within the controller whose label is 'chip'.
+ * Without a chip label the default GPIO controller is used.
+ */
+struct GpioDefinition
+{
+    std::string name;
+    std::string pin;
+    std::string direction;
+    std::string chip;
+    std::optional<uint32_t> offset;
+    // How long the line must be stable before a button accepts a
+    // change, 0 disables debouncing
+    uint32_t debounceMs = 0;
+    // The sustained number of D-Bus signals per second a button may
+    // send, 0 disables rate limiting
+    uint32_t signalRate = 20;
+    // How many signals may be sent back to back above that rate
+    uint32_t signalBurst = 10;
+    // How long the button must be held for each hold tier, empty
+    // for the default of the button type.  The first tier is a long
+    // press only for buttons that have long presses.
+    std::vector<uint32_t> holdMs;
+    // How soon after a click the next one must start to be part of
+    // the same gesture, 0 disables click counting
+    uint32_t clickMs = 0;
+};
+
+/**
+ * @brief One entry of the optional buttons array in gpio_defs.json
+ *
+ * Declares a button instance, so a system can have several buttons
+ * of the same type, e.g. one power button per sled.
+ */
+struct ButtonDefinition
+{
+    // The button type: power, reset or id
+    std::string type;
+    // The instance number, appended to the default object path
+    uint32_t index = 0;
+    // The name of the button GPIO in gpio_definitions
+    std::string gpio;
+    // The D-Bus object path, empty to use the default one
+    std::string path;
+};
+
+/**
+ * @brief One entry of the optional chords array in gpio_defs.json
+ *
+ * A chord is pressed when exactly its buttons are held down together
+ * for at least holdMs.
+ */
+struct ChordDefinition
+{
+    // The name sent with the ChordPressed signal, e.g. recovery
+    std::string name;
+    // The names of the button GPIOs in gpio_definitions
+    std::vector<std::string> gpios;
+    // How long the buttons must be held together, 0 for right away
+    uint32_t holdMs = 0;
+};
+
+/**
+ * @class GpioDefinitions
+ *
+ * Parses the GPIO definitions file once and indexes the entries
+ * by name, so every button can look up its configuration without
+ * reading the file again.
+ */
+class GpioDefinitions
+{
+  public:
+    /**
+     * @brief Constructor
+     *
+     * A missing or malformed file is logged and results in an
+     * empty set of definitions.
+     *
+     * @param[in] path - path to the GPIO definitions JSON file
+     */
+    explicit GpioDefinitions(const std::string& path = gpioDefsFile);
+
+    /**
+     * @brief Looks up a GPIO definition by name
+     *
+     * @param[in] gpioName - the GPIO name, e.g. POWER_BUTTON
+     *
+     * @return the definition, or nullptr if not defined
+     */
+    const GpioDefinition* find(const std::string& gpioName) const;
+
+    bool contains(const std::string& gpioName) const
+    {
+        return find(gpioName) != nullptr;
+    }
+
+    /**
+     * @brief The button instances declared in the file
+     *
+     * Empty if the file has no buttons array, in which case there is
+     * at most one button of each type, using its default GPIO name.
+     */
+    const std::vector<ButtonDefinition>& buttons() const
+    {
+        return buttonDefs;
+    }
+
+    /**
+     * @brief The chords declared in the file
+     */
+    const std::vector<ChordDefinition>& chords() const
+    {
+        return chordDefs;
+    }
+
+    /**
+     * @brief The backend selected by the optional top level
+     *        'gpio_backend' key, else the GPIO_BACKEND build option
+     */
+    GpioBackend backend() const
+    {
+        return gpioBackend;
+    }
+
+  private:
+    std::unordered_map<std::string, GpioDefinition> defs;
+    std::vector<ButtonDefinition> buttonDefs;
+    std::vector<ChordDefinition> chordDefs;
+    GpioBackend gpioBackend;
+};
+
+/**
+ * @brief A GPIO controller
+ *
+ * For the sysfs backend the path is the gpiochip directory under
+ * /sys/class/gpio, for the cdev backend it is the /dev/gpiochipN
+ * device node, which has no base.
+ */
+struct GpioChip
+{
+    std::string label;
+    std::string path;
+    uint32_t base = 0;
+    uint32_t ngpio = 0;
+};
+
+/**
+ * @class GpioChips
+ *
+ * Index of the GPIO controllers in the system, keyed by label.
+ * The controllers are scanned once, on the first lookup, no matter
+ * how many GPIOs are resolved against the index.  Character devices
+ * can also be looked up by their device name, e.g. gpiochip1.
+ */
+class GpioChips
+{
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] backend - the backend whose controllers are indexed
+     * @param[in] root - the directory to scan, defaults to
+     *                   /sys/class/gpio or /dev based on the backend
+     */
+    explicit GpioChips(GpioBackend backend = GpioBackend::sysfs,
+                       const std::string& root = {});
+
+    /**
+     * @brief Looks up a GPIO controller by its label
+     *
+     * @param[in] label - the controller label, e.g. 1e780000.gpio
+     *
+     * @return the controller, or nullptr if there is none
+     */
+    const GpioChip* find(const std::string& label) const;
+
+    /**
+     * @brief Indexes the controllers now instead of on the first
+     *        find(), so find() can then be called from several
+     *        threads at once
+     */
+    void scan() const;
+
+    GpioBackend backend() const
+    {
+        return gpioBackend;
+    }
+
+    /**
+     * @brief The directory the controllers are found in
+     */
+    const std::string& path() const
+    {
+        return root;
+    }
+
+  private:
+    void scanSysfs() const;
+    void scanCdev() const;
+
+    GpioBackend gpioBackend;
+    std::string root;
+    mutable bool scanned = false;
+    mutable std::unordered_map<std::string, GpioChip> chips;
+};
+
+/**
+ * @class GpioLine
+ *
+ * A configured GPIO line that edge events can be read from.
+ * The line is released when the object is destroyed.
+ */
+class GpioLine
+{
+  public:
+    GpioLine() = default;
+    virtual ~GpioLine() = default;
+    GpioLine(const GpioLine&) = delete;
+    GpioLine& operator=(const GpioLine&) = delete;
+    GpioLine(GpioLine&&) = delete;
+    GpioLine& operator=(GpioLine&&) = delete;
+
+    /**
+     * @brief The file descriptor to wait on for edges
+     */
+    virtual int fd() const = 0;
+
+    /**
+     * @brief The epoll events that signal pending edges on fd()
+     */
+    virtual uint32_t pollEvents() const = 0;
+
+    /**
+     * @brief Reads the pending edge events without blocking
+     *
+     * @param[out] events - filled with up to max events, oldest first
+     * @param[in] max - the capacity of events
+     *
+     * @return the number of events read, or a negative errno
+     */
+    virtual int readEvents(GpioEvent* events, size_t max) = 0;
+};
+
+/**
+ * @brief Configures a GPIO as described by its definition
+ *
+ * @param[in] defs - the GPIO definitions
+ * @param[in] chips - the GPIO controller index
+ * @param[in] gpioName - the GPIO name, e.g. POWER_BUTTON
+ *
+ * @return the configured line, or nullptr on failure
+ */
+std::unique_ptr<GpioLine> configGpio(const GpioDefinitions& defs,
+                                     const GpioChips& chips,
+                                     const std::string& gpioName);
 
 template <typename T>
-bool hasGpio()
+bool hasGpio(const GpioDefinitions& defs)
 {
-    return gpioDefined(T::getGpioName());
+    return defs.contains(T::getGpioName());
 }
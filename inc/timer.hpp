@@ -0,0 +1,76 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include "common.hpp"
+#include "timer_wheel.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+/**
+ * @class Timer
+ *
+ * A one shot CLOCK_MONOTONIC timer on the sd_event loop.  All timers
+ * of a loop share its TimerWheel and the one event source of that, so
+ * arming and cancelling them costs no system call.
+ */
+class Timer
+{
+  public:
+    /**
+     * @brief The timer callback
+     *
+     * @param[in] now - the CLOCK_MONOTONIC time of the loop iteration
+     *                  the timer fired in, in nanoseconds
+     */
+    using Callback = TimerWheel::Callback;
+
+    Timer() = delete;
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+    Timer(Timer&&) = delete;
+    Timer& operator=(Timer&&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] event - the sd_event loop
+     * @param[in] callback - called when the timer expires
+     *
+     * @throw std::runtime_error if the event source can't be added
+     */
+    Timer(EventPtr& event, Callback callback);
+
+    ~Timer();
+
+    /**
+     * @brief Arms the timer, replacing any earlier deadline
+     *
+     * @param[in] deadline - CLOCK_MONOTONIC expiry time in nanoseconds
+     */
+    void arm(uint64_t deadline);
+
+    /**
+     * @brief Disarms the timer
+     */
+    void cancel();
+
+  private:
+    std::shared_ptr<TimerWheel> wheel;
+    TimerWheel::Entry entry;
+};
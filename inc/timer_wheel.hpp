@@ -0,0 +1,187 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <systemd/sd-event.h>
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+
+/**
+ * @class TimerWheel
+ *
+ * A hierarchical timer wheel that serves every Timer of an sd_event
+ * loop from one sd_event timer source.
+ *
+ * Time is counted in 1 ms ticks.  Each level has 64 slots, each 64
+ * times as wide as those of the level below, so the 4 levels cover a
+ * block of 2^24 ticks, about 4.6 hours.  A timer goes in the lowest
+ * level whose slot still tells its deadline apart from the current
+ * time, and moves down a level whenever the wheel reaches its slot.
+ * Deadlines past the current block wait in an overflow list, which is
+ * placed again when the wheel gets to the start of the next block.
+ *
+ * Arming and cancelling a timer is a list insertion or removal.  A
+ * bitmask of the occupied slots of each level finds the next deadline
+ * without scanning.  The sd_event source is only armed for that, and
+ * only moved when it comes sooner, so an idle wheel has no wakeups at
+ * all and a busy one rarely touches the source.
+ */
+class TimerWheel
+{
+  public:
+    /**
+     * @brief The timer callback
+     *
+     * @param[in] now - the CLOCK_MONOTONIC time of the loop iteration
+     *                  the timer fired in, in nanoseconds
+     */
+    using Callback = std::function<void(uint64_t now)>;
+
+    /**
+     * @brief A link of the list of timers in a slot
+     */
+    struct Link
+    {
+        Link* prev = this;
+        Link* next = this;
+    };
+
+    /**
+     * @brief A timer as the wheel sees it, owned by a Timer
+     */
+    struct Entry : Link
+    {
+        Callback callback;
+        // The deadline in ticks, rounded up
+        uint64_t tick = 0;
+        bool armed = false;
+        uint8_t level = 0;
+        uint8_t slot = 0;
+    };
+
+    TimerWheel() = delete;
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+    TimerWheel& operator=(TimerWheel&&) = delete;
+
+    /**
+     * @brief Returns the wheel of a loop, creating it if there is none
+     *
+     * The wheel goes away with the last Timer that uses it.
+     *
+     * @param[in] loop - the sd_event loop
+     *
+     * @throw std::runtime_error if the event source can't be added
+     */
+    static std::shared_ptr<TimerWheel> get(sd_event* loop);
+
+    /**
+     * @brief Constructor, use get() instead
+     *
+     * @param[in] loop - the sd_event loop
+     *
+     * @throw std::runtime_error if the event source can't be added
+     */
+    explicit TimerWheel(sd_event* loop);
+
+    ~TimerWheel();
+
+    /**
+     * @brief Arms a timer, replacing any earlier deadline
+     *
+     * @param[in] entry - the timer
+     * @param[in] deadline - CLOCK_MONOTONIC expiry time in nanoseconds
+     */
+    void arm(Entry& entry, uint64_t deadline);
+
+    /**
+     * @brief Disarms a timer
+     *
+     * @param[in] entry - the timer
+     */
+    void cancel(Entry& entry);
+
+  private:
+    static constexpr unsigned levelBits = 6;
+    static constexpr unsigned levels = 4;
+    static constexpr size_t slots = 1 << levelBits;
+    static constexpr uint64_t slotMask = slots - 1;
+    static constexpr uint64_t tickNs = 1000000;
+    static constexpr unsigned blockBits = levelBits * levels;
+    static constexpr uint64_t blockMask = (1ULL << blockBits) - 1;
+
+    /**
+     * @brief Links a timer into the slot for its deadline
+     */
+    void insert(Entry& entry);
+
+    /**
+     * @brief Unlinks a timer from its slot
+     */
+    void unlink(Entry& entry);
+
+    /**
+     * @brief Takes every timer off a list, placing each again or, if
+     *        due, firing it
+     *
+     * @param[in] head - the slot or overflow list
+     * @param[in] fire - whether the timers due are fired
+     * @param[in] nowNs - the time passed to the callbacks
+     */
+    void expire(Link& head, bool fire, uint64_t nowNs);
+
+    /**
+     * @brief The tick of the first slot the wheel must visit next,
+     *        the deadline of a timer or where timers move down
+     */
+    std::optional<uint64_t> nextTick() const;
+
+    /**
+     * @brief Advances the wheel to a time, firing the timers due
+     *
+     * @param[in] nowNs - the current CLOCK_MONOTONIC time in ns
+     */
+    void run(uint64_t nowNs);
+
+    /**
+     * @brief Arms the sd_event source for nextTick() if that is sooner
+     *        than it is armed for, or disables it if there is none
+     */
+    void schedule();
+
+    static int timeoutHandler(sd_event_source* es, uint64_t usec,
+                              void* userdata);
+
+    sd_event* loop;
+    sd_event_source* source = nullptr;
+    std::array<std::array<Link, slots>, levels> wheel;
+    std::array<uint64_t, levels> occupied{};
+    // The timers due after the block the wheel is in, their level is
+    // set to levels
+    Link overflow;
+    // The tick the wheel is at
+    uint64_t now = 0;
+    // The armed timers
+    size_t count = 0;
+    // The tick the source is armed for, if any
+    std::optional<uint64_t> scheduled;
+    bool running = false;
+};
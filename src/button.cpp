@@ -0,0 +1,319 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button.hpp"
+
+#include "button_chords.hpp"
+#include "edge_capture.hpp"
+#include "flight_recorder.hpp"
+#include "xyz/openbmc_project/Chassis/Common/error.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <array>
+#include <phosphor-logging/elog-errors.hpp>
+#include <string>
+
+using namespace phosphor::logging;
+using sdbusplus::xyz::openbmc_project::Chassis::Common::Error::IOError;
+
+/**
+ * @brief The current CLOCK_MONOTONIC time in nanoseconds
+ */
+static uint64_t monotonicNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/**
+ * @brief Completes a button policy with the settings of its GPIO
+ *        definition, if it has one
+ */
+static ButtonPolicy completePolicy(ButtonPolicy policy,
+                                   const GpioDefinition* gpio)
+{
+    if (!gpio)
+    {
+        return policy;
+    }
+
+    policy.debounceTime = gpio->debounceMs * 1000000ULL;
+    policy.clickWindow = gpio->clickMs * 1000000ULL;
+    if (gpio->signalRate)
+    {
+        policy.signalInterval = 1000000000ULL / gpio->signalRate;
+        policy.signalBurst = std::max(gpio->signalBurst, 1u);
+    }
+
+    if (!gpio->holdMs.empty())
+    {
+        auto holdMs = gpio->holdMs;
+        std::sort(holdMs.begin(), holdMs.end());
+        holdMs.resize(std::min(holdMs.size(), maxHoldTiers));
+
+        policy.holdTiers = holdMs.size();
+        for (size_t i = 0; i < holdMs.size(); i++)
+        {
+            policy.holdTimes[i] = holdMs[i] * 1000000ULL;
+        }
+    }
+    return policy;
+}
+
+ButtonBase::ButtonBase(sdbusplus::bus::bus& bus, const char* path,
+                       EventPtr& event, const GpioDefinitions& gpioDefs,
+                       std::unique_ptr<GpioLine> line,
+                       const std::string& gpioName,
+                       const ButtonPolicy& policy) :
+    ButtonMachine(completePolicy(policy, gpioDefs.find(gpioName))),
+    gpioName(gpioName), loop(event.get()), line(std::move(line)),
+    statistics(bus, path, state),
+    timer(event, [this](uint64_t now) { timeout(now); })
+{
+    if (this->policy.holdTiers)
+    {
+        hold = std::make_unique<ButtonHold>(bus, path);
+    }
+
+    if (this->policy.clickWindow)
+    {
+        clicks = std::make_unique<ButtonClicks>(bus, path);
+    }
+
+    if (!this->line)
+    {
+        log<level::ERR>((gpioName + ": failed to config GPIO").c_str());
+        throw IOError();
+    }
+
+    int ret = sd_event_add_io(event.get(), &source, this->line->fd(),
+                              this->line->pollEvents(), EventHandler, this);
+    if (ret < 0)
+    {
+        log<level::ERR>((gpioName + ": failed to add to event loop").c_str());
+        throw IOError();
+    }
+
+    // When the loop falls behind, read the edges before running the
+    // timers that came due meanwhile, so the machine runs them in the
+    // order of the edge times
+    sd_event_source_set_priority(source, SD_EVENT_PRIORITY_IMPORTANT);
+}
+
+ButtonBase::~ButtonBase()
+{
+    sd_event_source_unref(source);
+}
+
+void ButtonBase::recordTo(TraceWriter& trace)
+{
+    traceLine = trace.addLine(gpioName, policy);
+    this->trace = &trace;
+}
+
+void ButtonBase::captureWith(EdgeCapture& capture)
+{
+    if (capture.add(*this, *line))
+    {
+        source = sd_event_source_unref(source);
+    }
+}
+
+void ButtonBase::chordWith(ButtonChords& chords)
+{
+    auto bit = chords.bit(gpioName);
+    if (bit)
+    {
+        this->chords = &chords;
+        chordBit = *bit;
+    }
+}
+
+void ButtonBase::forwardTo(ActionListener listener)
+{
+    this->listener = std::move(listener);
+}
+
+int ButtonBase::EventHandler(sd_event_source* es, int fd, uint32_t revents,
+                             void* userdata)
+{
+    auto button = static_cast<ButtonBase*>(userdata);
+
+    if (!button)
+    {
+        log<level::ERR>("Button event with null userdata!");
+        throw IOError();
+    }
+
+    std::array<GpioEvent, maxGpioEvents> events;
+    int n = button->line->readEvents(events.data(), events.size());
+    if (n < 0)
+    {
+        button->readFailed(-n);
+
+        // Keep serving the other buttons, but don't spin on a line
+        // that has gone away
+        if ((revents & EPOLLHUP) || ++button->failedReads >= maxFailedReads)
+        {
+            log<level::ERR>((button->gpioName + ": giving up on the line")
+                                .c_str());
+            sd_event_source_set_enabled(es, SD_EVENT_OFF);
+        }
+        return 0;
+    }
+
+    button->failedReads = 0;
+    button->edgesRead(events.data(), n);
+    return 0;
+}
+
+void ButtonBase::readFailed(int error)
+{
+    state.counters.readErrors++;
+    flightRecorder().record({now(), gpioName.c_str(),
+                             static_cast<uint32_t>(error),
+                             FlightRecorder::Kind::readError, 0});
+    log<level::ERR>((gpioName + ": read error!").c_str(),
+                    entry("ERRNO=%d", error));
+}
+
+void ButtonBase::edgesRead(const GpioEvent* events, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        flightRecorder().record({events[i].timestamp, gpioName.c_str(),
+                                 events[i].seqno, FlightRecorder::Kind::edge,
+                                 events[i].value});
+    }
+
+    if (trace && !trace->edges(traceLine, events, n))
+    {
+        log<level::ERR>(
+            (gpioName + ": failed to record edges, recording stopped")
+                .c_str());
+        trace = nullptr;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        auto lost = edge(events[i]);
+        if (lost)
+        {
+            flightRecorder().record({events[i].timestamp, gpioName.c_str(),
+                                     static_cast<uint32_t>(lost),
+                                     FlightRecorder::Kind::lostEdge,
+                                     events[i].value});
+        }
+    }
+    updateTimer();
+}
+
+void ButtonBase::timeout(uint64_t now)
+{
+    expire(now);
+    updateTimer();
+}
+
+void ButtonBase::updateTimer()
+{
+    auto deadline = nextDeadline();
+    if (deadline)
+    {
+        timer.arm(*deadline);
+    }
+    else
+    {
+        timer.cancel();
+    }
+}
+
+void ButtonBase::send(ButtonAction action, bool heldBack)
+{
+    if (heldBack)
+    {
+        auto dropped =
+            static_cast<unsigned long long>(state.rateLimit.droppedEdges);
+        log<level::INFO>((gpioName + ": rate limited edges").c_str(),
+                         entry("DROPPED=%llu", dropped));
+    }
+    deliver(action);
+}
+
+void ButtonBase::classified(ButtonAction action, const GpioEvent& event,
+                            bool sent)
+{
+    flightRecorder().record({now(), gpioName.c_str(), 0,
+                             FlightRecorder::Kind::action,
+                             static_cast<uint8_t>(action)});
+    if (sent)
+    {
+        // Signals held back by the rate limiter or a chord aren't
+        // counted, their latency is not the edge path's doing
+        recordLatency(state.counters.latency, monotonicNow() - event.timestamp);
+    }
+}
+
+void ButtonBase::held(uint8_t tier)
+{
+    auto holdMs = policy.holdTimes[tier - 1] / 1000000;
+
+    flightRecorder().record(
+        {now(), gpioName.c_str(), 0, FlightRecorder::Kind::held, tier});
+
+    log<level::INFO>((gpioName + ": held").c_str(), entry("TIER=%d", tier),
+                     entry("HOLD_MS=%llu",
+                           static_cast<unsigned long long>(holdMs)));
+    hold->held(tier, holdMs);
+}
+
+void ButtonBase::clicked(uint8_t count)
+{
+    flightRecorder().record(
+        {now(), gpioName.c_str(), 0, FlightRecorder::Kind::clicked, count});
+
+    log<level::INFO>((gpioName + ": clicked").c_str(),
+                     entry("CLICKS=%d", count));
+    clicks->clicked(count);
+}
+
+bool ButtonBase::chordLevel(bool pressed, uint64_t timestamp)
+{
+    return chords && chords->level(chordBit, pressed, timestamp);
+}
+
+bool ButtonBase::chordEngaged() const
+{
+    return chords && chords->engaged(chordBit);
+}
+
+void ButtonBase::deliver(ButtonAction action)
+{
+    emit(action);
+    if (listener)
+    {
+        listener(action);
+    }
+}
+
+uint64_t ButtonBase::now() const
+{
+    uint64_t usec = 0;
+    sd_event_now(loop, CLOCK_MONOTONIC, &usec);
+    return usec * 1000;
+}
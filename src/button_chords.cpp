@@ -0,0 +1,73 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_chords.hpp"
+
+#include <phosphor-logging/log.hpp>
+
+using namespace phosphor::logging;
+
+ButtonChords::ButtonChords(sdbusplus::bus::bus& bus, EventPtr& event,
+                           const std::vector<ChordDefinition>& chords) :
+    chordsIface(bus, buttonChordsPath, buttonChordsIface, vtable, this),
+    holdTimer(event, [this](uint64_t now) { update(now); })
+{
+    for (const auto& def : chords)
+    {
+        if (!tracker.add(def))
+        {
+            log<level::ERR>("Chord has no buttons, too many or the same "
+                            "buttons as another, skipped",
+                            entry("CHORD=%s", def.name.c_str()));
+        }
+    }
+}
+
+bool ButtonChords::level(uint8_t bit, bool pressed, uint64_t timestamp)
+{
+    auto engaged = tracker.level(bit, pressed, timestamp);
+    update(timestamp);
+    return engaged;
+}
+
+void ButtonChords::update(uint64_t now)
+{
+    auto press = tracker.pressed(now);
+    if (press)
+    {
+        log<level::INFO>("Button chord pressed",
+                         entry("CHORD=%s", press->name->c_str()));
+
+        auto m = chordsIface.new_signal("ChordPressed");
+        m.append(*press->name,
+                 static_cast<uint32_t>(press->heldTime / 1000000));
+        m.signal_send();
+    }
+
+    auto deadline = tracker.deadline();
+    if (deadline)
+    {
+        holdTimer.arm(*deadline);
+    }
+    else
+    {
+        holdTimer.cancel();
+    }
+}
+
+const sdbusplus::vtable::vtable_t ButtonChords::vtable[] = {
+    sdbusplus::vtable::start(), sdbusplus::vtable::signal("ChordPressed", "su"),
+    sdbusplus::vtable::end()};
@@ -0,0 +1,33 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_clicks.hpp"
+
+ButtonClicks::ButtonClicks(sdbusplus::bus::bus& bus, const char* path) :
+    clicksIface(bus, path, buttonClicksIface, vtable, this)
+{
+}
+
+void ButtonClicks::clicked(uint8_t count)
+{
+    auto m = clicksIface.new_signal("Clicked");
+    m.append(count);
+    m.signal_send();
+}
+
+const sdbusplus::vtable::vtable_t ButtonClicks::vtable[] = {
+    sdbusplus::vtable::start(), sdbusplus::vtable::signal("Clicked", "y"),
+    sdbusplus::vtable::end()};
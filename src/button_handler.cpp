@@ -26,129 +26,511 @@ constexpr auto mapperIface = "xyz.openbmc_project.ObjectMapper";
 constexpr auto ledGroupIface = "xyz.openbmc_project.Led.Group";
 
 constexpr auto mapperObjPath = "/xyz/openbmc_project/object_mapper";
+constexpr auto buttonsObjPath = "/xyz/openbmc_project/Chassis/Buttons";
 constexpr auto mapperService = "xyz.openbmc_project.ObjectMapper";
+constexpr auto ledGroupsObjPath = "/xyz/openbmc_project/led/groups";
 constexpr auto ledGroupBasePath = "/xyz/openbmc_project/led/groups/";
+constexpr auto stateBasePath = "/xyz/openbmc_project/state";
+
+// How long to wait for the replies of each kind of call, in us.  A
+// state change is only requested, so doesn't take longer than a lookup.
+constexpr uint64_t mapperTimeout = 2000000;
+constexpr uint64_t stateTimeout = 5000000;
+constexpr uint64_t ledTimeout = 2000000;
+
+/**
+ * @brief The property holding the current state for each of the
+ *        state interfaces the handler mirrors
+ */
+static const char* currentStateProperty(const std::string& interface)
+{
+    return (interface == chassisIface) ? "CurrentPowerState"
+                                       : "CurrentHostState";
+}
 
-Handler::Handler(sdbusplus::bus::bus& bus) : bus(bus)
+/**
+ * @brief The types the properties of the state interfaces can have
+ */
+using StateValue = std::variant<std::string, uint64_t, bool,
+                                std::vector<std::string>>;
+
+/**
+ * @brief Returns the instance number at the end of a button object
+ *        path, e.g. "2" for .../Buttons/Power2
+ *
+ * The same number selects the host and chassis the button acts on.
+ */
+static std::string getInstance(const std::string& path)
 {
-    try
+    auto instance = path.substr(path.find_last_not_of("0123456789") + 1);
+    return instance.empty() ? "0" : instance;
+}
+
+Handler::Handler(sdbusplus::bus::bus& bus, bool inProcess) :
+    bus(bus),
+    interfacesRemovedMatch(bus, sdbusRule::interfacesRemoved(),
+                           std::bind(std::mem_fn(&Handler::interfacesRemoved),
+                                     this, std::placeholders::_1))
+{
+    log<level::INFO>("Registering button handlers");
+
+    // In process the buttons call buttonAction() instead
+    if (!inProcess)
+    {
+        matchButtons();
+    }
+
+    // ID_LED_GROUP may list several groups, separated by commas
+    std::string groups{ID_LED_GROUP};
+    for (size_t pos = 0; pos != std::string::npos;)
     {
-        if (!getService(POWER_DBUS_OBJECT_NAME, powerButtonIface).empty())
+        auto next = groups.find(',', pos);
+        auto group = groups.substr(pos, next - pos);
+        pos = (next == std::string::npos) ? next : next + 1;
+
+        if (!group.empty())
         {
-            log<level::INFO>("Starting power button handler");
-            powerButtonReleased = std::make_unique<sdbusplus::bus::match_t>(
-                bus,
-                sdbusRule::type::signal() + sdbusRule::member("Released") +
-                    sdbusRule::path(POWER_DBUS_OBJECT_NAME) +
-                    sdbusRule::interface(powerButtonIface),
-                std::bind(std::mem_fn(&Handler::powerPressed), this,
-                          std::placeholders::_1));
-
-            powerButtonLongPressReleased =
-                std::make_unique<sdbusplus::bus::match_t>(
-                    bus,
-                    sdbusRule::type::signal() +
-                        sdbusRule::member("PressedLong") +
-                        sdbusRule::path(POWER_DBUS_OBJECT_NAME) +
-                        sdbusRule::interface(powerButtonIface),
-                    std::bind(std::mem_fn(&Handler::longPowerPressed), this,
-                              std::placeholders::_1));
+            idLedGroups.emplace(ledGroupBasePath + group, LedGroup{});
         }
     }
-    catch (SdBusError& e)
+
+    ledGroupChangedMatch = std::make_unique<sdbusplus::bus::match_t>(
+        bus,
+        sdbusRule::type::signal() + sdbusRule::member("PropertiesChanged") +
+            sdbusRule::path_namespace(ledGroupsObjPath) +
+            sdbusRule::interface(propertyIface) +
+            sdbusRule::argN(0, ledGroupIface),
+        std::bind(std::mem_fn(&Handler::ledGroupChanged), this,
+                  std::placeholders::_1));
+
+    for (const auto& group : idLedGroups)
     {
-        // The button wasn't implemented
+        readLedGroup(group.first);
     }
 
-    try
+    // Mirror the current chassis and host states, so a press can act
+    // without asking the state manager first
+    for (auto interface : {chassisIface, hostIface})
+    {
+        stateChangedMatches.push_back(std::make_unique<sdbusplus::bus::match_t>(
+            bus,
+            sdbusRule::type::signal() + sdbusRule::member("PropertiesChanged") +
+                sdbusRule::path_namespace(stateBasePath) +
+                sdbusRule::interface(propertyIface) +
+                sdbusRule::argN(0, interface),
+            std::bind(std::mem_fn(&Handler::stateChanged), this,
+                      std::placeholders::_1)));
+    }
+
+    loadStates();
+}
+
+void Handler::matchButtons()
+{
+    // Every instance of a button type is matched by one rule, so
+    // buttons may come and go without the handler probing for them.
+    powerButtonReleased = std::make_unique<sdbusplus::bus::match_t>(
+        bus,
+        sdbusRule::type::signal() + sdbusRule::member("Released") +
+            sdbusRule::path_namespace(buttonsObjPath) +
+            sdbusRule::interface(powerButtonIface),
+        [this](auto& msg) { powerPressed(msg.get_path()); });
+
+    powerButtonLongPressReleased = std::make_unique<sdbusplus::bus::match_t>(
+        bus,
+        sdbusRule::type::signal() + sdbusRule::member("PressedLong") +
+            sdbusRule::path_namespace(buttonsObjPath) +
+            sdbusRule::interface(powerButtonIface),
+        [this](auto& msg) { longPowerPressed(msg.get_path()); });
+
+    idButtonReleased = std::make_unique<sdbusplus::bus::match_t>(
+        bus,
+        sdbusRule::type::signal() + sdbusRule::member("Released") +
+            sdbusRule::path_namespace(buttonsObjPath) +
+            sdbusRule::interface(idButtonIface),
+        [this](auto& msg) { idPressed(msg.get_path()); });
+
+    resetButtonReleased = std::make_unique<sdbusplus::bus::match_t>(
+        bus,
+        sdbusRule::type::signal() + sdbusRule::member("Released") +
+            sdbusRule::path_namespace(buttonsObjPath) +
+            sdbusRule::interface(resetButtonIface),
+        [this](auto& msg) { resetPressed(msg.get_path()); });
+}
+
+void Handler::buttonAction(const std::string& type, const std::string& path,
+                           ButtonAction action)
+{
+    // The same actions the signal matches act on
+    if (type == "power")
     {
-        if (!getService(ID_DBUS_OBJECT_NAME, idButtonIface).empty())
+        if (action == ButtonAction::released)
+        {
+            powerPressed(path);
+        }
+        else if (action == ButtonAction::pressedLong)
         {
-            log<level::INFO>("Registering ID button handler");
-            idButtonReleased = std::make_unique<sdbusplus::bus::match_t>(
-                bus,
-                sdbusRule::type::signal() + sdbusRule::member("Released") +
-                    sdbusRule::path(ID_DBUS_OBJECT_NAME) +
-                    sdbusRule::interface(idButtonIface),
-                std::bind(std::mem_fn(&Handler::idPressed), this,
-                          std::placeholders::_1));
+            longPowerPressed(path);
         }
     }
-    catch (SdBusError& e)
+    else if (type == "reset" && action == ButtonAction::released)
+    {
+        resetPressed(path);
+    }
+    else if (type == "id" && action == ButtonAction::released)
     {
-        // The button wasn't implemented
+        idPressed(path);
     }
+}
+
+void Handler::watchService(const std::string& service)
+{
+    // Forget the services of a name once its owner changes
+    if (serviceWatches.find(service) == serviceWatches.end())
+    {
+        serviceWatches.emplace(
+            service,
+            std::make_unique<sdbusplus::bus::match_t>(
+                bus, sdbusRule::nameOwnerChanged(service),
+                std::bind(std::mem_fn(&Handler::serviceOwnerChanged), this,
+                          std::placeholders::_1)));
+    }
+}
 
+void Handler::callAsync(sdbusplus::message::message& method,
+                        uint64_t timeout, const char* what,
+                        ReplyCallback&& callback, FailCallback&& failed)
+{
+    auto& call = pendingCalls.emplace_back(*this, method.get_path(), what,
+                                           std::move(callback),
+                                           std::move(failed));
+    call.self = std::prev(pendingCalls.end());
+
+    auto r = sd_bus_call_async(bus.get(), &call.slot, method.get(),
+                               asyncReply, &call, timeout);
+    if (r < 0)
+    {
+        log<level::ERR>(what, entry("PATH=%s", call.path.c_str()),
+                        entry("ERRNO=%d", -r));
+        auto failed = std::move(call.failed);
+        pendingCalls.erase(call.self);
+        if (failed)
+        {
+            failed();
+        }
+    }
+}
+
+int Handler::asyncReply(sd_bus_message* msg, void* userData,
+                        sd_bus_error* retError)
+{
+    auto& call = *static_cast<PendingCall*>(userData);
+    sdbusplus::message::message reply{msg};
+
+    if (reply.is_method_error())
+    {
+        // Also how sd-bus reports a call that timed out
+        auto error = sd_bus_message_get_error(msg);
+        log<level::ERR>(call.what, entry("PATH=%s", call.path.c_str()),
+                        entry("ERROR=%s", error->message));
+        if (call.failed)
+        {
+            call.failed();
+        }
+    }
+    else if (call.callback)
+    {
+        try
+        {
+            call.callback(reply);
+        }
+        catch (std::exception& e)
+        {
+            log<level::ERR>(call.what, entry("PATH=%s", call.path.c_str()),
+                            entry("ERROR=%s", e.what()));
+            if (call.failed)
+            {
+                call.failed();
+            }
+        }
+    }
+
+    call.handler.pendingCalls.erase(call.self);
+    return 0;
+}
+
+void Handler::setProperty(const std::string& path, const std::string& interface,
+                          const std::string& property,
+                          const PropertyValue& value, uint64_t timeout,
+                          const char* what, std::function<void(bool)>&& done)
+{
+    FailCallback failed;
+    ReplyCallback succeeded;
+    if (done)
+    {
+        failed = [done]() { done(false); };
+        succeeded = [done](sdbusplus::message::message&) { done(true); };
+    }
+
+    getService(
+        path, interface,
+        [=](const std::string& service) mutable {
+            auto method = bus.new_method_call(service.c_str(), path.c_str(),
+                                              propertyIface, "Set");
+            method.append(interface, property, value);
+            callAsync(method, timeout, what, std::move(succeeded),
+                      std::move(failed));
+        },
+        FailCallback{failed});
+}
+
+void Handler::loadStates()
+{
+    auto method = bus.new_method_call(mapperService, mapperObjPath,
+                                      mapperIface, "GetSubTree");
+    method.append(stateBasePath, 0,
+                  std::vector<std::string>{chassisIface, hostIface});
+
+    // If this fails the states are read on the first press instead
+    callAsync(
+        method, mapperTimeout, "Could not load the chassis and host states",
+        [this](sdbusplus::message::message& reply) {
+            std::map<std::string,
+                     std::map<std::string, std::vector<std::string>>>
+                subtree;
+            reply.read(subtree);
+
+            for (const auto& [path, services] : subtree)
+            {
+                for (const auto& [service, interfaces] : services)
+                {
+                    for (const auto& interface : interfaces)
+                    {
+                        if (interface != chassisIface &&
+                            interface != hostIface)
+                        {
+                            continue;
+                        }
+                        serviceCache.emplace(std::make_pair(path, interface),
+                                             service);
+                        watchService(service);
+                        readState(service, path, interface);
+                    }
+                }
+            }
+        });
+}
+
+void Handler::readState(const std::string& service, const std::string& path,
+                        const std::string& interface,
+                        StateCallback&& callback)
+{
+    auto method = bus.new_method_call(service.c_str(), path.c_str(),
+                                      propertyIface, "Get");
+    method.append(interface, currentStateProperty(interface));
+
+    callAsync(method, stateTimeout, "Failed to read a state",
+              [this, service, path, interface,
+               callback = std::move(callback)](
+                  sdbusplus::message::message& reply) {
+                  std::variant<std::string> state;
+                  reply.read(state);
+
+                  currentStates[path] = std::get<std::string>(state);
+                  stateObjects[path] = std::make_pair(service, interface);
+
+                  if (callback)
+                  {
+                      callback(currentStates[path]);
+                  }
+              });
+}
+
+void Handler::stateChanged(sdbusplus::message::message& msg)
+{
     try
     {
-        if (!getService(RESET_DBUS_OBJECT_NAME, resetButtonIface).empty())
+        std::string interface;
+        std::map<std::string, StateValue> properties;
+        msg.read(interface, properties);
+
+        auto property = properties.find(currentStateProperty(interface));
+        if (property == properties.end())
+        {
+            return;
+        }
+
+        auto state = std::get_if<std::string>(&property->second);
+        if (state)
         {
-            log<level::INFO>("Registering reset button handler");
-            resetButtonReleased = std::make_unique<sdbusplus::bus::match_t>(
-                bus,
-                sdbusRule::type::signal() + sdbusRule::member("Released") +
-                    sdbusRule::path(RESET_DBUS_OBJECT_NAME) +
-                    sdbusRule::interface(resetButtonIface),
-                std::bind(std::mem_fn(&Handler::resetPressed), this,
-                          std::placeholders::_1));
+            currentStates[msg.get_path()] = *state;
         }
     }
-    catch (SdBusError& e)
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Failed to read a state change",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+void Handler::getCurrentState(const std::string& path,
+                              const std::string& interface,
+                              StateCallback&& callback)
+{
+    auto state = currentStates.find(path);
+    if (state != currentStates.end())
     {
-        // The button wasn't implemented
+        callback(state->second);
+        return;
     }
+
+    // Not seen yet, read it once and track it from now on
+    getService(path, interface,
+               [this, path, interface, callback = std::move(callback)](
+                   const std::string& service) mutable {
+                   readState(service, path, interface, std::move(callback));
+               });
 }
 
-std::string Handler::getService(const std::string& path,
-                                const std::string& interface) const
+void Handler::getService(const std::string& path,
+                         const std::string& interface,
+                         ServiceCallback&& callback, FailCallback&& failed)
 {
+    auto cached = serviceCache.find({path, interface});
+    if (cached != serviceCache.end())
+    {
+        callback(cached->second);
+        return;
+    }
+
     auto method = bus.new_method_call(mapperService, mapperObjPath, mapperIface,
                                       "GetObject");
     method.append(path, std::vector{interface});
-    auto result = bus.call(method);
-
-    std::map<std::string, std::vector<std::string>> objectData;
-    result.read(objectData);
 
-    return objectData.begin()->first;
+    callAsync(
+        method, mapperTimeout, "Failed to find the service of an object",
+        [this, path, interface, callback = std::move(callback),
+         failed](sdbusplus::message::message& reply) {
+            std::map<std::string, std::vector<std::string>> objectData;
+            reply.read(objectData);
+
+            if (objectData.empty())
+            {
+                if (failed)
+                {
+                    failed();
+                }
+                return;
+            }
+
+            auto& service = objectData.begin()->first;
+            serviceCache.emplace(std::make_pair(path, interface), service);
+            watchService(service);
+
+            callback(service);
+        },
+        std::move(failed));
 }
 
-bool Handler::poweredOn() const
+void Handler::serviceOwnerChanged(sdbusplus::message::message& msg)
 {
-    auto service = getService(CHASSIS_STATE_OBJECT_NAME, chassisIface);
-    auto method = bus.new_method_call(
-        service.c_str(), CHASSIS_STATE_OBJECT_NAME, propertyIface, "Get");
-    method.append(chassisIface, "CurrentPowerState");
-    auto result = bus.call(method);
+    std::string name;
+    std::string oldOwner;
+    std::string newOwner;
+    msg.read(name, oldOwner, newOwner);
 
-    std::variant<std::string> state;
-    result.read(state);
+    // The LED manager doesn't keep the group states across restarts
+    for (auto& [path, group] : idLedGroups)
+    {
+        auto cached = serviceCache.find({path, ledGroupIface});
+        if (cached != serviceCache.end() && cached->second == name)
+        {
+            group.asserted.reset();
+        }
+    }
+
+    for (auto it = serviceCache.begin(); it != serviceCache.end();)
+    {
+        if (it->second == name)
+        {
+            it = serviceCache.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
 
-    return Chassis::PowerState::On ==
-           Chassis::convertPowerStateFromString(std::get<std::string>(state));
+    // The states may have changed while the service was away
+    for (const auto& [path, object] : stateObjects)
+    {
+        const auto& [service, interface] = object;
+        if (service != name)
+        {
+            continue;
+        }
+
+        currentStates.erase(path);
+        if (!newOwner.empty())
+        {
+            // If this fails it is read again on the next press
+            readState(service, path, interface);
+        }
+    }
 }
 
-void Handler::powerPressed(sdbusplus::message::message& msg)
+void Handler::interfacesRemoved(sdbusplus::message::message& msg)
 {
-    auto transition = Host::Transition::On;
+    sdbusplus::message::object_path path;
+    std::vector<std::string> interfaces;
+    msg.read(path, interfaces);
 
-    try
+    for (const auto& interface : interfaces)
     {
-        if (poweredOn())
+        serviceCache.erase({path.str, interface});
+        if (interface == chassisIface || interface == hostIface)
         {
-            transition = Host::Transition::Off;
+            currentStates.erase(path.str);
         }
+        else if (interface == ledGroupIface)
+        {
+            auto group = idLedGroups.find(path.str);
+            if (group != idLedGroups.end())
+            {
+                group->second.asserted.reset();
+            }
+        }
+    }
+}
 
-        log<level::INFO>("Handling power button press");
+void Handler::poweredOn(const std::string& instance,
+                        std::function<void(bool)>&& callback)
+{
+    std::string chassisPath{CHASSIS_STATE_OBJECT_NAME + instance};
+    getCurrentState(chassisPath, chassisIface,
+                    [callback = std::move(callback)](const std::string& state) {
+                        callback(Chassis::PowerState::On ==
+                                 Chassis::convertPowerStateFromString(state));
+                    });
+}
 
-        std::variant<std::string> state = convertForMessage(transition);
+void Handler::powerPressed(const std::string& path)
+{
+    auto instance = getInstance(path);
+
+    try
+    {
+        poweredOn(instance, [this, instance](bool on) {
+            auto transition = on ? Host::Transition::Off : Host::Transition::On;
 
-        auto service = getService(HOST_STATE_OBJECT_NAME, hostIface);
-        auto method = bus.new_method_call(
-            service.c_str(), HOST_STATE_OBJECT_NAME, propertyIface, "Set");
-        method.append(hostIface, "RequestedHostTransition", state);
+            log<level::INFO>("Handling power button press",
+                             entry("INSTANCE=%s", instance.c_str()));
 
-        bus.call(method);
+            setProperty(HOST_STATE_OBJECT_NAME + instance, hostIface,
+                        "RequestedHostTransition",
+                        convertForMessage(transition), stateTimeout,
+                        "Failed power state change on a power button press");
+        });
     }
     catch (SdBusError& e)
     {
@@ -157,105 +539,213 @@ void Handler::powerPressed(sdbusplus::message::message& msg)
     }
 }
 
-void Handler::longPowerPressed(sdbusplus::message::message& msg)
+void Handler::longPowerPressed(const std::string& path)
 {
+    auto instance = getInstance(path);
+
     try
     {
-        if (!poweredOn())
-        {
-            log<level::INFO>(
-                "Power is off so ignoring long power button press");
-            return;
-        }
-
-        log<level::INFO>("Handling long power button press");
-
-        std::variant<std::string> state =
-            convertForMessage(Chassis::Transition::Off);
+        poweredOn(instance, [this, instance](bool on) {
+            if (!on)
+            {
+                log<level::INFO>(
+                    "Power is off so ignoring long power button press");
+                return;
+            }
+
+            log<level::INFO>("Handling long power button press",
+                             entry("INSTANCE=%s", instance.c_str()));
+
+            setProperty(CHASSIS_STATE_OBJECT_NAME + instance, chassisIface,
+                        "RequestedPowerTransition",
+                        convertForMessage(Chassis::Transition::Off),
+                        stateTimeout,
+                        "Failed powering off on long power button press");
+        });
+    }
+    catch (SdBusError& e)
+    {
+        log<level::ERR>("Failed powering off on long power button press",
+                        entry("ERROR=%s", e.what()));
+    }
+}
 
-        auto service = getService(CHASSIS_STATE_OBJECT_NAME, chassisIface);
-        auto method = bus.new_method_call(
-            service.c_str(), CHASSIS_STATE_OBJECT_NAME, propertyIface, "Set");
-        method.append(chassisIface, "RequestedPowerTransition", state);
+void Handler::resetPressed(const std::string& path)
+{
+    auto instance = getInstance(path);
 
-        bus.call(method);
+    try
+    {
+        poweredOn(instance, [this, instance](bool on) {
+            if (!on)
+            {
+                log<level::INFO>("Power is off so ignoring reset button press");
+                return;
+            }
+
+            log<level::INFO>("Handling reset button press",
+                             entry("INSTANCE=%s", instance.c_str()));
+
+            setProperty(HOST_STATE_OBJECT_NAME + instance, hostIface,
+                        "RequestedHostTransition",
+                        convertForMessage(Host::Transition::Reboot),
+                        stateTimeout,
+                        "Failed power state change on a reset button press");
+        });
     }
     catch (SdBusError& e)
     {
-        log<level::ERR>("Failed powering off on long power button press",
+        log<level::ERR>("Failed power state change on a reset button press",
                         entry("ERROR=%s", e.what()));
     }
 }
 
-void Handler::resetPressed(sdbusplus::message::message& msg)
+void Handler::idPressed(const std::string& path)
 {
     try
     {
-        if (!poweredOn())
+        toggleIdLeds();
+    }
+    catch (SdBusError& e)
+    {
+        log<level::ERR>("Error toggling ID LED group on ID button press",
+                        entry("ERROR=%s", e.what()));
+    }
+}
+
+void Handler::toggleIdLeds()
+{
+    if (idLedGroups.empty())
+    {
+        return;
+    }
+
+    // Toggle relative to the latest requested state, and if any group
+    // is on turn them all off
+    std::optional<bool> current;
+    for (const auto& [path, group] : idLedGroups)
+    {
+        auto state = group.target     ? group.target
+                     : group.inflight ? group.inflight
+                                      : group.asserted;
+        if (state)
         {
-            log<level::INFO>("Power is off so ignoring reset button press");
-            return;
+            current = current.value_or(false) || *state;
         }
+    }
 
-        log<level::INFO>("Handling reset button press");
+    if (!current)
+    {
+        // Nothing seen yet, read one group once and act on that
+        readLedGroup(idLedGroups.begin()->first, [this]() {
+            if (idLedGroups.begin()->second.asserted)
+            {
+                toggleIdLeds();
+            }
+        });
+        return;
+    }
 
-        std::variant<std::string> state =
-            convertForMessage(Host::Transition::Reboot);
+    log<level::INFO>("Changing ID LED group state on ID LED press",
+                     entry("STATE=%d", !*current));
 
-        auto service = getService(HOST_STATE_OBJECT_NAME, hostIface);
-        auto method = bus.new_method_call(
-            service.c_str(), HOST_STATE_OBJECT_NAME, propertyIface, "Set");
+    for (auto& [path, group] : idLedGroups)
+    {
+        group.target = !*current;
+        writeLedGroup(path);
+    }
+}
 
-        method.append(hostIface, "RequestedHostTransition", state);
+void Handler::writeLedGroup(const std::string& path)
+{
+    auto& group = idLedGroups[path];
+    if (group.inflight || !group.target)
+    {
+        return;
+    }
 
-        bus.call(method);
+    bool asserted = *group.target;
+    group.target.reset();
+    if (group.asserted == asserted)
+    {
+        return;
+    }
+
+    group.inflight = asserted;
+    try
+    {
+        setProperty(path, ledGroupIface, "Asserted", asserted, ledTimeout,
+                    "Error toggling ID LED group on ID button press",
+                    [this, path, asserted](bool done) {
+                        auto& group = idLedGroups[path];
+                        group.inflight.reset();
+                        if (done)
+                        {
+                            group.asserted = asserted;
+                        }
+
+                        // Presses made meanwhile may have asked for
+                        // another state
+                        writeLedGroup(path);
+                    });
     }
     catch (SdBusError& e)
     {
-        log<level::ERR>("Failed power state change on a reset button press",
-                        entry("ERROR=%s", e.what()));
+        group.inflight.reset();
+        throw;
     }
 }
 
-void Handler::idPressed(sdbusplus::message::message& msg)
+void Handler::readLedGroup(const std::string& path,
+                           std::function<void()>&& callback)
 {
-    std::string groupPath{ledGroupBasePath};
-    groupPath += ID_LED_GROUP;
-
-    auto service = getService(groupPath, ledGroupIface);
+    getService(path, ledGroupIface,
+               [this, path, callback = std::move(callback)](
+                   const std::string& service) mutable {
+                   auto method = bus.new_method_call(
+                       service.c_str(), path.c_str(), propertyIface, "Get");
+                   method.append(ledGroupIface, "Asserted");
+
+                   callAsync(method, ledTimeout,
+                             "Failed to read an LED group state",
+                             [this, path, callback = std::move(callback)](
+                                 sdbusplus::message::message& reply) {
+                                 std::variant<bool> asserted;
+                                 reply.read(asserted);
+
+                                 idLedGroups[path].asserted =
+                                     std::get<bool>(asserted);
+                                 if (callback)
+                                 {
+                                     callback();
+                                 }
+                             });
+               });
+}
 
-    if (service.empty())
+void Handler::ledGroupChanged(sdbusplus::message::message& msg)
+{
+    auto group = idLedGroups.find(msg.get_path());
+    if (group == idLedGroups.end())
     {
-        log<level::INFO>("No identify LED group found during ID button press",
-                         entry("GROUP=%s", groupPath.c_str()));
         return;
     }
 
     try
     {
-        auto method = bus.new_method_call(service.c_str(), groupPath.c_str(),
-                                          propertyIface, "Get");
-        method.append(ledGroupIface, "Asserted");
-        auto result = bus.call(method);
-
-        std::variant<bool> state;
-        result.read(state);
-
-        state = !std::get<bool>(state);
-
-        log<level::INFO>("Changing ID LED group state on ID LED press",
-                         entry("GROUP=%s", groupPath.c_str()),
-                         entry("STATE=%d", std::get<bool>(state)));
+        std::string interface;
+        std::map<std::string, std::variant<bool>> properties;
+        msg.read(interface, properties);
 
-        method = bus.new_method_call(service.c_str(), groupPath.c_str(),
-                                     propertyIface, "Set");
-
-        method.append(ledGroupIface, "Asserted", state);
-        result = bus.call(method);
+        auto asserted = properties.find("Asserted");
+        if (asserted != properties.end())
+        {
+            group->second.asserted = std::get<bool>(asserted->second);
+        }
     }
-    catch (SdBusError& e)
+    catch (std::exception& e)
     {
-        log<level::ERR>("Error toggling ID LED group on ID button press",
+        log<level::ERR>("Failed to read an LED group state change",
                         entry("ERROR=%s", e.what()));
     }
 }
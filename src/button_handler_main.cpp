@@ -1,15 +1,45 @@
 #include "button_handler.hpp"
+#include "common.hpp"
+
+#include <phosphor-logging/log.hpp>
 
 int main(int argc, char* argv[])
 {
+    int ret = 0;
+
+    sd_event* event = nullptr;
+    ret = sd_event_default(&event);
+    if (ret < 0)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            "Error creating a default sd_event handler");
+        return ret;
+    }
+    EventPtr eventP{event};
+    event = nullptr;
+
     auto bus = sdbusplus::bus::new_default();
 
-    phosphor::button::Handler handler{bus};
+    try
+    {
+        // The handler's method calls are all asynchronous, their
+        // replies are dispatched from this loop along with the signals
+        bus.attach_event(eventP.get(), SD_EVENT_PRIORITY_NORMAL);
+
+        phosphor::button::Handler handler{bus};
 
-    while (true)
+        ret = sd_event_loop(eventP.get());
+        if (ret < 0)
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                "Error occurred during the sd_event_loop",
+                phosphor::logging::entry("RET=%d", ret));
+        }
+    }
+    catch (std::exception& e)
     {
-        bus.process_discard();
-        bus.wait();
+        phosphor::logging::log<phosphor::logging::level::ERR>(e.what());
+        ret = -1;
     }
-    return 0;
+    return ret;
 }
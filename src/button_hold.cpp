@@ -14,9 +14,20 @@
 // limitations under the License.
 */
 
-#include "id_button.hpp"
+#include "button_hold.hpp"
 
-void IDButton::simPress()
+ButtonHold::ButtonHold(sdbusplus::bus::bus& bus, const char* path) :
+    holdIface(bus, path, buttonHoldIface, vtable, this)
 {
-    pressed();
-}
\ No newline at end of file
+}
+
+void ButtonHold::held(uint8_t tier, uint32_t holdMs)
+{
+    auto m = holdIface.new_signal("Held");
+    m.append(tier, holdMs);
+    m.signal_send();
+}
+
+const sdbusplus::vtable::vtable_t ButtonHold::vtable[] = {
+    sdbusplus::vtable::start(), sdbusplus::vtable::signal("Held", "yu"),
+    sdbusplus::vtable::end()};
@@ -0,0 +1,210 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_machine.hpp"
+
+#include <algorithm>
+#include <utility>
+
+uint64_t ButtonMachine::edge(const GpioEvent& event)
+{
+    expire(event.timestamp);
+    clock = std::max(clock, event.timestamp);
+
+    state.counters.edges++;
+    auto lost = state.counters.lostEdges;
+    auto missed = trackEdge(state, event);
+    if (missed)
+    {
+        feedEdge(*missed);
+    }
+    feedEdge(event);
+    return state.counters.lostEdges - lost;
+}
+
+ButtonMachine::Timeout ButtonMachine::nextTimeout(uint64_t& deadline) const
+{
+    auto timeout = Timeout::none;
+    auto due = [&timeout, &deadline](Timeout t, uint64_t time) {
+        if (timeout == Timeout::none || time < deadline)
+        {
+            timeout = t;
+            deadline = time;
+        }
+    };
+
+    // On a tie the debounce goes first, so the hold sees the release
+    const auto& debounce = state.debounce;
+    if (debounce.pending)
+    {
+        due(Timeout::debounce, debounce.deadline);
+    }
+    if (state.rateLimit.pending != ButtonAction::none)
+    {
+        due(Timeout::rateLimit, rateLimitDeadline(state.rateLimit, policy));
+    }
+
+    // A burst of edges that started before the hold deadline may
+    // settle as a release from before it, the hold waits for it
+    auto hold = holdDeadline(state, policy);
+    if (hold && !(debounce.pending && debounce.pendingEdge.timestamp < *hold))
+    {
+        due(Timeout::hold, *hold);
+    }
+
+    auto click = clickDeadline(state);
+    if (policy.clickWindow && click)
+    {
+        due(Timeout::click, *click);
+    }
+    return timeout;
+}
+
+std::optional<uint64_t> ButtonMachine::nextDeadline() const
+{
+    uint64_t deadline = 0;
+    if (nextTimeout(deadline) == Timeout::none)
+    {
+        return std::nullopt;
+    }
+    return deadline;
+}
+
+void ButtonMachine::expire(uint64_t now)
+{
+    uint64_t deadline = 0;
+    for (auto timeout = nextTimeout(deadline);
+         timeout != Timeout::none && deadline <= now;
+         timeout = nextTimeout(deadline))
+    {
+        clock = std::max(clock, deadline);
+
+        switch (timeout)
+        {
+            case Timeout::debounce:
+            {
+                auto edge = debounceSettle(state.debounce, clock);
+                if (edge)
+                {
+                    handleEdge(*edge);
+                }
+                break;
+            }
+            case Timeout::rateLimit:
+            {
+                auto action = rateLimitFlush(state.rateLimit, policy, clock);
+                if (action != ButtonAction::none)
+                {
+                    send(action, true);
+                }
+                break;
+            }
+            case Timeout::hold:
+                if (holdExpired(state, policy, clock) && !chordEngaged())
+                {
+                    // A long press ends the gesture of the clicks
+                    // before it, which go out first
+                    if (state.holdTier == 1 && state.click.count)
+                    {
+                        gestureOver(std::exchange(state.click.count, 0));
+                    }
+                    if (state.holdTier == 1 && policy.longPress)
+                    {
+                        signal(ButtonAction::pressedLong);
+                    }
+                    held(state.holdTier);
+                }
+                break;
+            case Timeout::click:
+            {
+                auto count = clickExpired(state, clock);
+                if (count)
+                {
+                    gestureOver(count);
+                }
+                break;
+            }
+            case Timeout::none:
+                break;
+        }
+    }
+}
+
+void ButtonMachine::feedEdge(const GpioEvent& event)
+{
+    auto edge = debounceEdge(state.debounce, policy, event);
+    if (edge)
+    {
+        handleEdge(*edge);
+    }
+}
+
+void ButtonMachine::handleEdge(const GpioEvent& event)
+{
+    auto wasPressed = state.pressed;
+    auto action = processEdge(state, policy, event);
+    bool inChord = false;
+    if (state.pressed != wasPressed)
+    {
+        inChord = chordLevel(state.pressed, event.timestamp);
+        if (policy.clickWindow)
+        {
+            // A press that is part of a chord is no click, and ends the
+            // gesture before it
+            auto count = inChord ? std::exchange(state.click, {}).count
+                                 : clickEdge(state, policy, event.timestamp);
+            if (count)
+            {
+                gestureOver(count);
+            }
+        }
+    }
+    if (action == ButtonAction::none)
+    {
+        return;
+    }
+
+    // The release of a click waits for the gesture to be over
+    bool clickRelease = policy.clickWindow && !inChord &&
+                        action == ButtonAction::released && state.click.count;
+    bool sent = !inChord && !clickRelease && signal(action);
+    classified(action, event, sent);
+    if (!inChord && action == ButtonAction::pressedLong)
+    {
+        held(state.holdTier);
+    }
+}
+
+void ButtonMachine::gestureOver(uint8_t count)
+{
+    if (count == 1)
+    {
+        signal(ButtonAction::released);
+    }
+    clicked(count);
+}
+
+bool ButtonMachine::signal(ButtonAction action)
+{
+    action = rateLimitAction(state.rateLimit, policy, action, clock);
+    if (action == ButtonAction::none)
+    {
+        return false;
+    }
+
+    send(action, false);
+    return true;
+}
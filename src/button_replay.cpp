@@ -0,0 +1,413 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_machine.hpp"
+#include "button_trace.hpp"
+#include "chord_tracker.hpp"
+
+#include <getopt.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+const char* actionName(ButtonAction action)
+{
+    switch (action)
+    {
+        case ButtonAction::pressed:
+            return "Pressed";
+        case ButtonAction::released:
+            return "Released";
+        case ButtonAction::pressedLong:
+            return "PressedLong";
+        case ButtonAction::none:
+            break;
+    }
+    return "None";
+}
+
+class Replay;
+
+/**
+ * @class ReplayLine
+ *
+ * A traced line, run through the ButtonMachine its button had.
+ */
+class ReplayLine : public ButtonMachine
+{
+  public:
+    ReplayLine(Replay& replay, const std::string& name,
+               const ButtonPolicy& policy) :
+        ButtonMachine(policy),
+        name(name), replay(replay)
+    {
+    }
+
+    const std::string name;
+    uint64_t signals = 0;
+
+  protected:
+    void send(ButtonAction action, bool heldBack) override;
+
+    void held(uint8_t tier) override;
+
+    void clicked(uint8_t count) override;
+
+    bool chordLevel(bool pressed, uint64_t timestamp) override;
+
+    bool chordEngaged() const override;
+
+  private:
+    Replay& replay;
+};
+
+/**
+ * @class Replay
+ *
+ * Feeds the edges of a trace through the ButtonMachines of the lines
+ * and runs their timers and those of the chords, in the order they
+ * are due, on the clock of the trace.
+ */
+class Replay
+{
+  public:
+    /**
+     * @brief Constructor
+     *
+     * @param[in] realTime - wait between edges as long as the trace
+     *                       did, else replay as fast as possible
+     * @param[in] quiet - don't print the signals
+     */
+    Replay(bool realTime, bool quiet) : realTime(realTime), quiet(quiet)
+    {
+    }
+
+    void addLine(const TraceLine& line)
+    {
+        std::string name(line.name.data(),
+                         strnlen(line.name.data(), line.name.size()));
+        lines.push_back(
+            std::make_unique<ReplayLine>(*this, name, line.policy()));
+    }
+
+    void addChord(const TraceChord& chord)
+    {
+        auto def = chord.definition();
+        if (!chords.add(def))
+        {
+            fprintf(stderr, "Chord %s skipped, as the daemon did\n",
+                    def.name.c_str());
+        }
+    }
+
+    void edge(const TraceRecord& record)
+    {
+        if (record.line >= lines.size())
+        {
+            fprintf(stderr, "Edge on unknown line %u, skipped\n", record.line);
+            return;
+        }
+
+        GpioEvent event{record.timestamp, record.seqno, record.value};
+        advance(event.timestamp);
+        waitUntil(event.timestamp);
+        lines[record.line]->edge(event);
+    }
+
+    /**
+     * @brief Runs the timers still armed at the end of the trace
+     */
+    void finish()
+    {
+        advance(std::numeric_limits<uint64_t>::max());
+    }
+
+    const std::vector<std::unique_ptr<ReplayLine>>& replayed() const
+    {
+        return lines;
+    }
+
+    uint64_t chordsPressed() const
+    {
+        return pressedChords;
+    }
+
+    bool chordLevel(const ReplayLine& line, bool pressed, uint64_t timestamp)
+    {
+        auto bit = chords.bit(line.name);
+        if (!bit)
+        {
+            return false;
+        }
+
+        auto engaged = chords.level(*bit, pressed, timestamp);
+        chordPressed(timestamp);
+        return engaged;
+    }
+
+    bool chordEngaged(const ReplayLine& line) const
+    {
+        auto bit = chords.bit(line.name);
+        return bit && chords.engaged(*bit);
+    }
+
+    void report(const std::string& name, uint64_t now, const char* signal)
+    {
+        if (!quiet)
+        {
+            printf("%llu.%09llu %s %s\n",
+                   static_cast<unsigned long long>(now / 1000000000),
+                   static_cast<unsigned long long>(now % 1000000000),
+                   name.c_str(), signal);
+        }
+    }
+
+  private:
+    /**
+     * @brief Runs the timers of every line and of the chords that
+     *        expire by a time, in the order they expire
+     */
+    void advance(uint64_t now)
+    {
+        while (true)
+        {
+            std::optional<uint64_t> deadline;
+            ReplayLine* next = nullptr;
+            for (auto& line : lines)
+            {
+                auto due = line->nextDeadline();
+                if (due && *due <= now && (!deadline || *due < *deadline))
+                {
+                    deadline = due;
+                    next = line.get();
+                }
+            }
+
+            auto chord = chords.deadline();
+            if (chord && *chord <= now && (!deadline || *chord < *deadline))
+            {
+                deadline = chord;
+                next = nullptr;
+            }
+
+            if (!deadline)
+            {
+                return;
+            }
+            waitUntil(*deadline);
+
+            if (next)
+            {
+                next->expire(*deadline);
+            }
+            else
+            {
+                chordPressed(*deadline);
+            }
+        }
+    }
+
+    void chordPressed(uint64_t now)
+    {
+        auto press = chords.pressed(now);
+        if (press)
+        {
+            pressedChords++;
+            auto signal = "ChordPressed " + *press->name + " " +
+                          std::to_string(press->heldTime / 1000000);
+            report("Chords", now, signal.c_str());
+        }
+    }
+
+    /**
+     * @brief Sleeps until the time of the trace comes up, when
+     *        replaying at the recorded speed
+     */
+    void waitUntil(uint64_t time)
+    {
+        if (!realTime)
+        {
+            return;
+        }
+
+        if (!started)
+        {
+            started = true;
+            wallStart = std::chrono::steady_clock::now();
+            traceStart = time;
+        }
+        std::this_thread::sleep_until(
+            wallStart + std::chrono::nanoseconds(time - traceStart));
+    }
+
+    bool realTime;
+    bool quiet;
+    bool started = false;
+    std::chrono::steady_clock::time_point wallStart;
+    uint64_t traceStart = 0;
+    std::vector<std::unique_ptr<ReplayLine>> lines;
+    ChordTracker chords;
+    uint64_t pressedChords = 0;
+};
+
+void ReplayLine::send(ButtonAction action, bool heldBack)
+{
+    signals++;
+    replay.report(name, clockNow(), actionName(action));
+}
+
+void ReplayLine::held(uint8_t tier)
+{
+    signals++;
+    auto held = "Held " + std::to_string(tier);
+    replay.report(name, clockNow(), held.c_str());
+}
+
+void ReplayLine::clicked(uint8_t count)
+{
+    signals++;
+    auto clicked = "Clicked " + std::to_string(count);
+    replay.report(name, clockNow(), clicked.c_str());
+}
+
+bool ReplayLine::chordLevel(bool pressed, uint64_t timestamp)
+{
+    return replay.chordLevel(*this, pressed, timestamp);
+}
+
+bool ReplayLine::chordEngaged() const
+{
+    return replay.chordEngaged(*this);
+}
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options] <trace>\n"
+            "Replays a trace recorded by buttons --record and prints the\n"
+            "signals the buttons would have sent.\n"
+            "  --fast   Replay as fast as possible, not at recorded speed\n"
+            "  --quiet  Only print the summary\n",
+            name);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    bool realTime = true;
+    bool quiet = false;
+
+    static const option options[] = {{"fast", no_argument, nullptr, 'f'},
+                                     {"quiet", no_argument, nullptr, 'q'},
+                                     {nullptr, 0, nullptr, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "fq", options, nullptr)) != -1)
+    {
+        switch (opt)
+        {
+            case 'f':
+                realTime = false;
+                break;
+            case 'q':
+                quiet = true;
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind + 1 != argc)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    try
+    {
+        TraceReader reader{argv[optind]};
+        Replay replay{realTime, quiet};
+
+        auto start = std::chrono::steady_clock::now();
+        uint64_t edges = 0;
+
+        TraceRecord record;
+        TraceLine line;
+        TraceChord chord;
+        while (reader.next(record, line, chord))
+        {
+            switch (record.type)
+            {
+                case TraceRecordType::line:
+                    replay.addLine(line);
+                    break;
+                case TraceRecordType::chord:
+                    replay.addChord(chord);
+                    break;
+                case TraceRecordType::edge:
+                    replay.edge(record);
+                    edges++;
+                    break;
+            }
+        }
+        replay.finish();
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+
+        using ull = unsigned long long;
+        for (const auto& l : replay.replayed())
+        {
+            const auto& state = l->buttonState();
+            printf("%s: %llu edges, %llu presses, %llu long presses, "
+                   "%llu lost, %llu filtered, %llu dropped, %llu signals\n",
+                   l->name.c_str(), static_cast<ull>(state.counters.edges),
+                   static_cast<ull>(state.counters.presses),
+                   static_cast<ull>(state.counters.longPresses),
+                   static_cast<ull>(state.counters.lostEdges),
+                   static_cast<ull>(state.debounce.filteredEdges),
+                   static_cast<ull>(state.rateLimit.droppedEdges),
+                   static_cast<ull>(l->signals));
+        }
+        if (replay.chordsPressed())
+        {
+            printf("%llu chords pressed\n",
+                   static_cast<ull>(replay.chordsPressed()));
+        }
+        printf("Replayed %llu edges in %.6f s, %.0f edges/s\n",
+               static_cast<unsigned long long>(edges), elapsed.count(),
+               elapsed.count() > 0 ? edges / elapsed.count() : 0.0);
+    }
+    catch (std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+    return 0;
+}
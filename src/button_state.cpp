@@ -0,0 +1,289 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_state.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+// The upper bound of the first latency bucket, in microseconds
+static constexpr uint64_t firstLatencyBound = 64;
+
+uint64_t latencyBound(size_t bucket)
+{
+    if (bucket + 1 >= latencyBuckets)
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+    return firstLatencyBound << bucket;
+}
+
+void recordLatency(LatencyHistogram& histogram, uint64_t latency)
+{
+    uint64_t usec = latency / 1000;
+
+    // Bucket i > 0 holds [64us << (i - 1), 64us << i)
+    size_t bucket = 0;
+    if (usec >= firstLatencyBound)
+    {
+        size_t log2 = 63 - __builtin_clzll(usec);
+        bucket = std::min(log2 - 5, latencyBuckets - 1);
+    }
+    histogram.counts[bucket]++;
+}
+
+uint8_t clickEdge(ButtonState& state, const ButtonPolicy& policy,
+                  uint64_t timestamp)
+{
+    auto& click = state.click;
+    if (state.pressed)
+    {
+        return clickExpired(state, timestamp);
+    }
+
+    if (state.holdTier)
+    {
+        return std::exchange(click.count, 0);
+    }
+
+    if (click.count < std::numeric_limits<uint8_t>::max())
+    {
+        click.count++;
+    }
+    click.deadline = timestamp + policy.clickWindow;
+    return 0;
+}
+
+std::optional<uint64_t> clickDeadline(const ButtonState& state)
+{
+    if (state.pressed || !state.click.count)
+    {
+        return std::nullopt;
+    }
+    return state.click.deadline;
+}
+
+uint8_t clickExpired(ButtonState& state, uint64_t now)
+{
+    auto& click = state.click;
+    if (!click.count || now < click.deadline)
+    {
+        return 0;
+    }
+
+    auto count = click.count;
+    click.count = 0;
+    return count;
+}
+
+std::optional<GpioEvent> trackEdge(ButtonState& state, const GpioEvent& event)
+{
+    auto& track = state.track;
+
+    uint64_t lost = 0;
+    if (event.seqno && event.seqno > track.seqno + 1)
+    {
+        lost = event.seqno - track.seqno - 1;
+    }
+
+    std::optional<GpioEvent> missed;
+    if (track.seen && event.value == track.level)
+    {
+        missed = event;
+        missed->value = !event.value;
+        lost = std::max<uint64_t>(lost, 1);
+    }
+
+    state.counters.lostEdges += lost;
+    track.level = event.value;
+    track.seqno = event.seqno;
+    track.seen = true;
+    return missed;
+}
+
+ButtonAction processEdge(ButtonState& state, const ButtonPolicy& policy,
+                         const GpioEvent& event)
+{
+    if (event.value == 0)
+    {
+        state.pressedTime = event.timestamp;
+        state.pressed = true;
+        state.holdTier = 0;
+        state.counters.presses++;
+        return ButtonAction::pressed;
+    }
+
+    bool wasPressed = state.pressed;
+    state.pressed = false;
+
+    if (!policy.longPress)
+    {
+        return ButtonAction::released;
+    }
+
+    if (wasPressed && state.holdTier)
+    {
+        // The hold was already reported while the button was down
+        return ButtonAction::none;
+    }
+
+    // The hold timer may not have run yet if the loop was busy, so
+    // measure the press between the two edges too, with the same
+    // bound as holdExpired()
+    if (wasPressed && policy.holdTiers &&
+        event.timestamp - state.pressedTime >= policy.holdTimes[0])
+    {
+        state.holdTier = 1;
+        state.counters.longPresses++;
+        return ButtonAction::pressedLong;
+    }
+    return ButtonAction::released;
+}
+
+std::optional<uint64_t> holdDeadline(const ButtonState& state,
+                                     const ButtonPolicy& policy)
+{
+    if (!state.pressed || state.holdTier >= policy.holdTiers)
+    {
+        return std::nullopt;
+    }
+    return state.pressedTime + policy.holdTimes[state.holdTier];
+}
+
+bool holdExpired(ButtonState& state, const ButtonPolicy& policy,
+                 uint64_t now)
+{
+    auto deadline = holdDeadline(state, policy);
+    if (!deadline || now < *deadline)
+    {
+        return false;
+    }
+
+    state.holdTier++;
+    if (state.holdTier == 1 && policy.longPress)
+    {
+        state.counters.longPresses++;
+    }
+    return true;
+}
+
+std::optional<GpioEvent> debounceEdge(DebounceState& state,
+                                      const ButtonPolicy& policy,
+                                      const GpioEvent& event)
+{
+    if (!policy.debounceTime)
+    {
+        return event;
+    }
+
+    if (state.pending)
+    {
+        // The previous edge of the burst was a bounce
+        state.filteredEdges++;
+        state.pendingEdge.value = event.value;
+    }
+    else
+    {
+        state.pendingEdge = event;
+        state.pending = true;
+    }
+    state.deadline = event.timestamp + policy.debounceTime;
+
+    return std::nullopt;
+}
+
+std::optional<GpioEvent> debounceSettle(DebounceState& state, uint64_t now)
+{
+    if (!state.pending || now < state.deadline)
+    {
+        return std::nullopt;
+    }
+
+    state.pending = false;
+    if (state.pendingEdge.value == state.stableValue)
+    {
+        // The whole burst was a glitch
+        state.filteredEdges++;
+        return std::nullopt;
+    }
+
+    state.stableValue = state.pendingEdge.value;
+    return state.pendingEdge;
+}
+
+uint64_t rateLimitDeadline(const RateLimitState& state,
+                           const ButtonPolicy& policy)
+{
+    uint64_t allowance = (policy.signalBurst - 1) * policy.signalInterval;
+    return (state.nextTime > allowance) ? state.nextTime - allowance : 0;
+}
+
+/**
+ * @brief Takes a token if one is available
+ */
+static bool rateLimitTake(RateLimitState& state, const ButtonPolicy& policy,
+                          uint64_t now)
+{
+    if (now < rateLimitDeadline(state, policy))
+    {
+        return false;
+    }
+    state.nextTime = std::max(state.nextTime, now) + policy.signalInterval;
+    return true;
+}
+
+ButtonAction rateLimitAction(RateLimitState& state, const ButtonPolicy& policy,
+                             ButtonAction action, uint64_t now)
+{
+    if (policy.signalInterval &&
+        (state.pending != ButtonAction::none ||
+         !rateLimitTake(state, policy, now)))
+    {
+        // Keep order: once held back, later actions queue behind it
+        state.pending = action;
+        state.droppedEdges++;
+        return ButtonAction::none;
+    }
+
+    state.emittedPressed = (action == ButtonAction::pressed);
+    return action;
+}
+
+ButtonAction rateLimitFlush(RateLimitState& state, const ButtonPolicy& policy,
+                            uint64_t now)
+{
+    if (state.pending == ButtonAction::none ||
+        !rateLimitTake(state, policy, now))
+    {
+        return ButtonAction::none;
+    }
+
+    auto action = state.pending;
+    state.pending = ButtonAction::none;
+
+    bool pressed = (action == ButtonAction::pressed);
+    if (pressed == state.emittedPressed)
+    {
+        // The burst ended where it started
+        return ButtonAction::none;
+    }
+
+    // The held back action is signaled after all
+    state.droppedEdges--;
+    state.emittedPressed = pressed;
+    return action;
+}
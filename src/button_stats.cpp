@@ -0,0 +1,127 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_stats.hpp"
+
+#include <vector>
+
+// The counters change with every edge and send no PropertiesChanged,
+// so none of the emits flags is set and the properties introspect as
+// EmitsChangedSignal=false.  sdbusplus has no name for that.
+static constexpr decltype(sdbusplus::vtable::vtable_t::flags) emitsFalse = 0;
+
+ButtonStatistics::ButtonStatistics(sdbusplus::bus::bus& bus,
+                                   const char* path,
+                                   const ButtonState& state) :
+    state(state),
+    statsIface(bus, path, buttonStatsIface, vtable, this)
+{
+}
+
+int ButtonStatistics::getFilteredEdges(sd_bus* bus, const char* path,
+                                       const char* interface,
+                                       const char* property,
+                                       sd_bus_message* reply, void* context,
+                                       sd_bus_error* error)
+{
+    auto stats = static_cast<ButtonStatistics*>(context);
+    sdbusplus::message::message m(reply);
+    m.append(stats->state.debounce.filteredEdges);
+    return true;
+}
+
+int ButtonStatistics::getDroppedEdges(sd_bus* bus, const char* path,
+                                      const char* interface,
+                                      const char* property,
+                                      sd_bus_message* reply, void* context,
+                                      sd_bus_error* error)
+{
+    auto stats = static_cast<ButtonStatistics*>(context);
+    sdbusplus::message::message m(reply);
+    m.append(stats->state.rateLimit.droppedEdges);
+    return true;
+}
+
+template <uint64_t ButtonCounters::*counter>
+int ButtonStatistics::getCounter(sd_bus* bus, const char* path,
+                                 const char* interface, const char* property,
+                                 sd_bus_message* reply, void* context,
+                                 sd_bus_error* error)
+{
+    auto stats = static_cast<ButtonStatistics*>(context);
+    sdbusplus::message::message m(reply);
+    m.append(stats->state.counters.*counter);
+    return true;
+}
+
+int ButtonStatistics::getSignalLatency(sd_bus* bus, const char* path,
+                                       const char* interface,
+                                       const char* property,
+                                       sd_bus_message* reply, void* context,
+                                       sd_bus_error* error)
+{
+    auto stats = static_cast<ButtonStatistics*>(context);
+    const auto& counts = stats->state.counters.latency.counts;
+    sdbusplus::message::message m(reply);
+    m.append(std::vector<uint64_t>(counts.begin(), counts.end()));
+    return true;
+}
+
+int ButtonStatistics::getSignalLatencyBounds(sd_bus* bus, const char* path,
+                                             const char* interface,
+                                             const char* property,
+                                             sd_bus_message* reply,
+                                             void* context,
+                                             sd_bus_error* error)
+{
+    std::vector<uint64_t> bounds;
+    for (size_t i = 0; i < latencyBuckets; i++)
+    {
+        bounds.push_back(latencyBound(i));
+    }
+
+    sdbusplus::message::message m(reply);
+    m.append(bounds);
+    return true;
+}
+
+const sdbusplus::vtable::vtable_t ButtonStatistics::vtable[] = {
+    sdbusplus::vtable::start(),
+    sdbusplus::vtable::property("FilteredEdges", "t", getFilteredEdges,
+                                emitsFalse),
+    sdbusplus::vtable::property("DroppedEdges", "t", getDroppedEdges,
+                                emitsFalse),
+    sdbusplus::vtable::property("Edges", "t",
+                                getCounter<&ButtonCounters::edges>,
+                                emitsFalse),
+    sdbusplus::vtable::property("Presses", "t",
+                                getCounter<&ButtonCounters::presses>,
+                                emitsFalse),
+    sdbusplus::vtable::property("LongPresses", "t",
+                                getCounter<&ButtonCounters::longPresses>,
+                                emitsFalse),
+    sdbusplus::vtable::property("ReadErrors", "t",
+                                getCounter<&ButtonCounters::readErrors>,
+                                emitsFalse),
+    sdbusplus::vtable::property("LostEdges", "t",
+                                getCounter<&ButtonCounters::lostEdges>,
+                                emitsFalse),
+    sdbusplus::vtable::property("SignalLatency", "at", getSignalLatency,
+                                emitsFalse),
+    sdbusplus::vtable::property("SignalLatencyBounds", "at",
+                                getSignalLatencyBounds,
+                                sdbusplus::vtable::property_::const_),
+    sdbusplus::vtable::end()};
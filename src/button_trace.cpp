@@ -0,0 +1,207 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_trace.hpp"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+static_assert(sizeof(TraceRecord) == 16, "Trace records must be 16 bytes");
+
+ButtonPolicy TraceLine::policy() const
+{
+    ButtonPolicy policy;
+    policy.debounceTime = debounceTime;
+    policy.signalInterval = signalInterval;
+    policy.signalBurst = signalBurst;
+    policy.holdTimes = holdTimes;
+    policy.holdTiers = std::min<size_t>(holdTiers, maxHoldTiers);
+    policy.longPress = !holdOnly;
+    policy.clickWindow = clickMs * 1000000ULL;
+    return policy;
+}
+
+/**
+ * @brief The string in a fixed size name field
+ */
+static std::string nameOf(const std::array<char, 32>& field)
+{
+    return {field.data(), strnlen(field.data(), field.size())};
+}
+
+ChordDefinition TraceChord::definition() const
+{
+    ChordDefinition def;
+    def.name = nameOf(name);
+    def.holdMs = holdMs;
+    for (const auto& gpio : gpios)
+    {
+        if (gpio[0])
+        {
+            def.gpios.push_back(nameOf(gpio));
+        }
+    }
+    return def;
+}
+
+TraceWriter::TraceWriter(const std::string& path)
+{
+    fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        throw std::runtime_error("Failed to open " + path + ": " +
+                                 std::strerror(errno));
+    }
+
+    TraceHeader header{traceMagic, traceVersion, 0};
+    if (!write(&header, sizeof(header)))
+    {
+        throw std::runtime_error("Failed to write " + path);
+    }
+}
+
+TraceWriter::~TraceWriter()
+{
+    if (fd >= 0)
+    {
+        ::close(fd);
+    }
+}
+
+uint16_t TraceWriter::addLine(const std::string& name,
+                              const ButtonPolicy& policy)
+{
+    struct
+    {
+        TraceRecord record;
+        TraceLine line;
+    } entry{};
+
+    entry.record.line = lines;
+    entry.record.type = TraceRecordType::line;
+    name.copy(entry.line.name.data(), entry.line.name.size() - 1);
+    entry.line.debounceTime = policy.debounceTime;
+    entry.line.signalInterval = policy.signalInterval;
+    entry.line.holdTimes = policy.holdTimes;
+    entry.line.signalBurst = policy.signalBurst;
+    entry.line.holdTiers = policy.holdTiers;
+    entry.line.holdOnly = !policy.longPress;
+    entry.line.clickMs = std::min<uint64_t>(policy.clickWindow / 1000000,
+                                            UINT16_MAX);
+
+    write(&entry, sizeof(entry));
+    return lines++;
+}
+
+void TraceWriter::addChord(const ChordDefinition& chord)
+{
+    if (chord.gpios.size() > ChordTracker::maxChordButtons)
+    {
+        return;
+    }
+
+    struct
+    {
+        TraceRecord record;
+        TraceChord chord;
+    } entry{};
+
+    entry.record.type = TraceRecordType::chord;
+    chord.name.copy(entry.chord.name.data(), entry.chord.name.size() - 1);
+    entry.chord.holdMs = chord.holdMs;
+    for (size_t i = 0; i < chord.gpios.size(); i++)
+    {
+        auto& gpio = entry.chord.gpios[i];
+        chord.gpios[i].copy(gpio.data(), gpio.size() - 1);
+    }
+
+    write(&entry, sizeof(entry));
+}
+
+bool TraceWriter::edges(uint16_t line, const GpioEvent* events, size_t count)
+{
+    std::array<TraceRecord, maxGpioEvents> records;
+    count = std::min(count, records.size());
+
+    for (size_t i = 0; i < count; i++)
+    {
+        records[i] = {events[i].timestamp, events[i].seqno, line,
+                      TraceRecordType::edge, events[i].value};
+    }
+    return write(records.data(), count * sizeof(records[0]));
+}
+
+bool TraceWriter::write(const void* data, size_t size)
+{
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    auto written = ::write(fd, data, size);
+    if (written != static_cast<ssize_t>(size))
+    {
+        ::close(fd);
+        fd = -1;
+        return false;
+    }
+    return true;
+}
+
+TraceReader::TraceReader(const std::string& path) :
+    stream(path, std::ios::binary)
+{
+    TraceHeader header{};
+    if (!stream.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != traceMagic)
+    {
+        throw std::runtime_error(path + " is not a button trace");
+    }
+
+    // Version 1 only lacks the click window, which then reads as none,
+    // and versions before 3 the chords
+    if (header.version < 1 || header.version > traceVersion)
+    {
+        throw std::runtime_error(path + " has an unsupported trace version");
+    }
+}
+
+bool TraceReader::next(TraceRecord& record, TraceLine& line,
+                       TraceChord& chord)
+{
+    if (!stream.read(reinterpret_cast<char*>(&record), sizeof(record)))
+    {
+        return false;
+    }
+
+    switch (record.type)
+    {
+        case TraceRecordType::line:
+            return static_cast<bool>(
+                stream.read(reinterpret_cast<char*>(&line), sizeof(line)));
+        case TraceRecordType::chord:
+            return static_cast<bool>(
+                stream.read(reinterpret_cast<char*>(&chord), sizeof(chord)));
+        case TraceRecordType::edge:
+            break;
+    }
+    return true;
+}
@@ -0,0 +1,134 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "chord_tracker.hpp"
+
+#include <algorithm>
+#include <vector>
+
+bool ChordTracker::add(const ChordDefinition& def)
+{
+    if (def.gpios.size() > maxChordButtons)
+    {
+        return false;
+    }
+
+    // Buttons new to the chords only get their bit once the chord is
+    // accepted
+    uint64_t mask = 0;
+    std::vector<std::string> added;
+    for (const auto& gpio : def.gpios)
+    {
+        auto found = bits.find(gpio);
+        if (found != bits.end())
+        {
+            mask |= 1ULL << found->second;
+            continue;
+        }
+
+        auto index = std::find(added.begin(), added.end(), gpio);
+        if (index == added.end())
+        {
+            index = added.insert(added.end(), gpio);
+        }
+        size_t bit = bits.size() + (index - added.begin());
+        if (bit >= maxButtons)
+        {
+            return false;
+        }
+        mask |= 1ULL << bit;
+    }
+
+    Chord chord{def.name, def.holdMs * 1000000ULL};
+    if (!mask || !chords.emplace(mask, std::move(chord)).second)
+    {
+        return false;
+    }
+    for (const auto& gpio : added)
+    {
+        bits.emplace(gpio, bits.size());
+    }
+
+    // Each subset of two or more of its buttons may be forming it
+    for (auto subset = mask; subset; subset = (subset - 1) & mask)
+    {
+        if (subset & (subset - 1))
+        {
+            forming.insert(subset);
+        }
+    }
+    return true;
+}
+
+std::optional<uint8_t> ChordTracker::bit(const std::string& gpioName) const
+{
+    auto found = bits.find(gpioName);
+    if (found == bits.end())
+    {
+        return std::nullopt;
+    }
+    return found->second;
+}
+
+bool ChordTracker::level(uint8_t bit, bool pressed, uint64_t timestamp)
+{
+    if (pressed)
+    {
+        levels |= 1ULL << bit;
+    }
+    else
+    {
+        levels &= ~(1ULL << bit);
+    }
+
+    if (forming.count(levels))
+    {
+        engagedMask |= levels;
+    }
+    auto wasEngaged = engaged(bit);
+    if (!pressed)
+    {
+        engagedMask &= ~(1ULL << bit);
+    }
+
+    // Any change ends the chord held, if the buttons now form another
+    // one its hold starts over
+    auto chord = chords.find(levels);
+    held = (chord != chords.end()) ? &chord->second : nullptr;
+    heldSince = timestamp;
+    return wasEngaged;
+}
+
+std::optional<uint64_t> ChordTracker::deadline() const
+{
+    if (!held)
+    {
+        return std::nullopt;
+    }
+    return heldSince + held->holdTime;
+}
+
+std::optional<ChordTracker::Press> ChordTracker::pressed(uint64_t now)
+{
+    if (!held || now < heldSince + held->holdTime)
+    {
+        return std::nullopt;
+    }
+
+    Press press{&held->name, now - heldSince};
+    held = nullptr;
+    return press;
+}
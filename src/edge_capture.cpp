@@ -0,0 +1,326 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "edge_capture.hpp"
+
+#include "button.hpp"
+
+#include <limits.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <phosphor-logging/log.hpp>
+#include <stdexcept>
+#include <system_error>
+
+using namespace phosphor::logging;
+
+/**
+ * @brief Signals an eventfd
+ */
+static bool notify(int fd)
+{
+    uint64_t one = 1;
+    return write(fd, &one, sizeof(one)) == sizeof(one);
+}
+
+EdgeCapture::EdgeCapture(EventPtr& event, const CaptureConfig& config) :
+    config(config)
+{
+    wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    stopFd = eventfd(0, EFD_CLOEXEC);
+    if (wakeFd < 0 || stopFd < 0)
+    {
+        int error = errno;
+        close(wakeFd);
+        close(stopFd);
+        log<level::ERR>("Failed to create the capture eventfds",
+                        entry("ERRNO=%d", error));
+        throw std::runtime_error("Failed to create eventfd");
+    }
+
+    // The stop eventfd is the one watched without a line
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.ptr = nullptr;
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, stopFd, &ev) < 0)
+    {
+        int error = errno;
+        close(epollFd);
+        close(wakeFd);
+        close(stopFd);
+        log<level::ERR>("Failed to create the capture epoll instance",
+                        entry("ERRNO=%d", error));
+        throw std::runtime_error("Failed to create epoll instance");
+    }
+
+    int ret = sd_event_add_io(event.get(), &source, wakeFd, EPOLLIN, drain,
+                              this);
+    if (ret < 0)
+    {
+        close(epollFd);
+        close(wakeFd);
+        close(stopFd);
+        log<level::ERR>("Failed to add the capture ring to the event loop",
+                        entry("RET=%d", ret));
+        throw std::runtime_error("Failed to add capture ring");
+    }
+
+    // Like the lines it stands in for, the ring is drained before the
+    // timers that came due while the loop was busy
+    sd_event_source_set_priority(source, SD_EVENT_PRIORITY_IMPORTANT);
+}
+
+EdgeCapture::~EdgeCapture()
+{
+    if (started)
+    {
+        notify(stopFd);
+        pthread_join(thread, nullptr);
+    }
+
+    sd_event_source_unref(source);
+    close(epollFd);
+    close(wakeFd);
+    close(stopFd);
+}
+
+bool EdgeCapture::add(ButtonBase& button, GpioLine& line)
+{
+    auto& added = lines.emplace_back(Line{&button, &line, 0});
+
+    epoll_event ev{};
+    ev.events = line.pollEvents();
+    ev.data.ptr = &added;
+    if (epoll_ctl(epollFd, EPOLL_CTL_ADD, line.fd(), &ev) < 0)
+    {
+        log<level::ERR>("Failed to watch a line in the capture thread",
+                        entry("ERRNO=%d", errno));
+        lines.pop_back();
+        return false;
+    }
+    return true;
+}
+
+void EdgeCapture::start()
+{
+    // Keep the thread clear of page faults, its stack included: the
+    // stack is mapped after this, so it is locked in as it is mapped
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) < 0)
+    {
+        log<level::WARNING>("Failed to lock the process memory",
+                            entry("ERRNO=%d", errno));
+    }
+
+    pthread_attr_t attr;
+    int ret = pthread_attr_init(&attr);
+    if (ret)
+    {
+        throw std::system_error(ret, std::generic_category(),
+                                "Failed to start the capture thread");
+    }
+    ret = pthread_attr_setstacksize(
+        &attr, std::max<size_t>(stackSize, PTHREAD_STACK_MIN));
+    if (!ret)
+    {
+        ret = pthread_create(&thread, &attr, threadMain, this);
+    }
+    pthread_attr_destroy(&attr);
+    if (ret)
+    {
+        throw std::system_error(ret, std::generic_category(),
+                                "Failed to start the capture thread");
+    }
+    started = true;
+}
+
+void* EdgeCapture::threadMain(void* capture)
+{
+    static_cast<EdgeCapture*>(capture)->run();
+    return nullptr;
+}
+
+void EdgeCapture::schedule() const
+{
+    if (config.cpu >= 0)
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpu, &cpus);
+        int ret = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (ret)
+        {
+            log<level::WARNING>("Failed to pin the capture thread",
+                                entry("CPU=%d", config.cpu),
+                                entry("ERRNO=%d", ret));
+        }
+    }
+
+    if (config.priority > 0)
+    {
+        sched_param param{};
+        param.sched_priority = config.priority;
+        int ret = pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+        if (ret)
+        {
+            log<level::WARNING>("Failed to make the capture thread real time",
+                                entry("PRIORITY=%d", config.priority),
+                                entry("ERRNO=%d", ret));
+        }
+    }
+}
+
+void EdgeCapture::run()
+{
+    schedule();
+
+    std::array<epoll_event, 8> ready;
+    std::array<GpioEvent, maxGpioEvents> events;
+    for (;;)
+    {
+        int n = epoll_wait(epollFd, ready.data(), ready.size(), -1);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            log<level::ERR>("Capture thread wait failed",
+                            entry("ERRNO=%d", errno));
+            break;
+        }
+
+        bool queued = false;
+        for (int i = 0; i < n; i++)
+        {
+            if (!ready[i].data.ptr)
+            {
+                return;
+            }
+
+            auto& line = *static_cast<Line*>(ready[i].data.ptr);
+            int count = line.line->readEvents(events.data(), events.size());
+            if (count < 0)
+            {
+                queued |= push({line.button, {}, -count});
+
+                // Don't spin on a line that has gone away
+                if ((ready[i].events & EPOLLHUP) ||
+                    ++line.failedReads >= maxFailedReads)
+                {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, line.line->fd(),
+                              nullptr);
+                }
+                continue;
+            }
+
+            line.failedReads = 0;
+            for (int j = 0; j < count; j++)
+            {
+                queued |= push({line.button, events[j], 0});
+            }
+        }
+
+        // One wakeup of the loop for everything read in this pass
+        if (queued)
+        {
+            notify(wakeFd);
+        }
+    }
+}
+
+bool EdgeCapture::push(const Capture& capture)
+{
+    auto h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == ringSize)
+    {
+        overflows.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    ring[h % ringSize] = capture;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+int EdgeCapture::drain(sd_event_source* es, int fd, uint32_t revents,
+                       void* userdata)
+{
+    auto capture = static_cast<EdgeCapture*>(userdata);
+
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    {
+        log<level::ERR>("Failed to read the capture eventfd",
+                        entry("ERRNO=%d", errno));
+    }
+
+    // Hand consecutive edges of a button over in one batch, as if the
+    // loop had read them itself
+    std::array<GpioEvent, maxGpioEvents> batch;
+    ButtonBase* button = nullptr;
+    int n = 0;
+    auto flush = [&]() {
+        if (n)
+        {
+            button->edgesRead(batch.data(), n);
+            n = 0;
+        }
+    };
+
+    auto t = capture->tail.load(std::memory_order_relaxed);
+    auto h = capture->head.load(std::memory_order_acquire);
+    for (; t != h; t++)
+    {
+        const auto& captured = capture->ring[t % ringSize];
+        if (captured.button != button || captured.error ||
+            n == static_cast<int>(batch.size()))
+        {
+            flush();
+            button = captured.button;
+        }
+
+        if (captured.error)
+        {
+            button->readFailed(captured.error);
+        }
+        else
+        {
+            batch[n++] = captured.event;
+        }
+    }
+    flush();
+    capture->tail.store(t, std::memory_order_release);
+
+    auto dropped = capture->overflows.load(std::memory_order_relaxed);
+    if (dropped != capture->overflowsLogged)
+    {
+        log<level::WARNING>("Capture ring full, edges dropped",
+                            entry("DROPPED=%llu",
+                                  static_cast<unsigned long long>(
+                                      dropped - capture->overflowsLogged)));
+        capture->overflowsLogged = dropped;
+    }
+
+    return 0;
+}
@@ -0,0 +1,70 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "flight_recorder.hpp"
+
+#include <algorithm>
+#include <phosphor-logging/log.hpp>
+
+using namespace phosphor::logging;
+
+static const char* kindName(FlightRecorder::Kind kind)
+{
+    switch (kind)
+    {
+        case FlightRecorder::Kind::edge:
+            return "edge";
+        case FlightRecorder::Kind::action:
+            return "action";
+        case FlightRecorder::Kind::held:
+            return "held";
+        case FlightRecorder::Kind::readError:
+            return "read error";
+        case FlightRecorder::Kind::lostEdge:
+            return "lost edge";
+        case FlightRecorder::Kind::clicked:
+            return "clicked";
+    }
+    return "unknown";
+}
+
+void FlightRecorder::dump() const
+{
+    auto end = next.load(std::memory_order_acquire);
+    auto begin = end - std::min<uint64_t>(end, capacity);
+
+    log<level::INFO>("Button flight recorder dump",
+                     entry("ENTRIES=%llu",
+                           static_cast<unsigned long long>(end - begin)));
+
+    for (auto i = begin; i < end; i++)
+    {
+        const auto& e = entries[i % capacity];
+        log<level::INFO>(
+            "Button flight recorder entry",
+            entry("TIMESTAMP=%llu",
+                  static_cast<unsigned long long>(e.timestamp)),
+            entry("SOURCE=%s", e.source ? e.source : ""),
+            entry("KIND=%s", kindName(e.kind)), entry("VALUE=%u", e.value),
+            entry("DETAIL=%u", e.detail));
+    }
+}
+
+FlightRecorder& flightRecorder()
+{
+    static FlightRecorder recorder;
+    return recorder;
+}
@@ -19,8 +19,16 @@
 #include "settings.hpp"
 
 #include <fcntl.h>
+#include <linux/gpio.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <time.h>
 #include <unistd.h>
 
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
 #include <experimental/filesystem>
 #include <fstream>
 #include <gpioplus/utility/aspeed.hpp>
@@ -29,13 +37,10 @@
 #include <phosphor-logging/log.hpp>
 #include <tuple>
 
-const std::string gpioDev = "/sys/class/gpio";
-static constexpr auto gpioDefs = "/etc/default/obmc/gpio/gpio_defs.json";
-
 using namespace phosphor::logging;
 namespace fs = std::experimental::filesystem;
 
-void closeGpio(int fd)
+static void closeGpio(int fd)
 {
     if (fd > 0)
     {
@@ -43,256 +48,803 @@ void closeGpio(int fd)
     }
 }
 
-uint32_t getGpioBase()
+static uint64_t monotonicNow()
 {
-    // Look for a /sys/class/gpio/gpiochip*/label file
-    // with a value of GPIO_BASE_LABEL_NAME.  Then read
-    // the base value from the 'base' file in that directory.
-#ifdef LOOKUP_GPIO_BASE
-    for (auto& f : fs::directory_iterator(gpioDev))
+    timespec ts;
+    ::clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+std::optional<GpioBackend> toGpioBackend(const std::string& name)
+{
+    if (name == "sysfs")
+    {
+        return GpioBackend::sysfs;
+    }
+    if (name == "cdev")
+    {
+        return GpioBackend::cdev;
+    }
+    return std::nullopt;
+}
+
+GpioChips::GpioChips(GpioBackend backend, const std::string& root) :
+    gpioBackend(backend), root(root)
+{
+    if (this->root.empty())
+    {
+        this->root =
+            (backend == GpioBackend::cdev) ? gpioCdevRoot : gpioSysfsRoot;
+    }
+}
+
+void GpioChips::scan() const
+{
+    if (scanned)
+    {
+        return;
+    }
+    scanned = true;
+
+    if (gpioBackend == GpioBackend::cdev)
+    {
+        scanCdev();
+    }
+    else
     {
-        std::string path{f.path()};
-        if (path.find("gpiochip") == std::string::npos)
+        scanSysfs();
+    }
+}
+
+void GpioChips::scanCdev() const
+{
+    // Index every /dev/gpiochip* device by the label the driver reports
+    try
+    {
+        for (auto& f : fs::directory_iterator(root))
         {
-            continue;
+            std::string path{f.path()};
+            if (f.path().filename().string().find("gpiochip") != 0)
+            {
+                continue;
+            }
+
+            int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+            {
+                log<level::ERR>("Skipping unreadable GPIO chip",
+                                entry("PATH=%s", path.c_str()));
+                continue;
+            }
+
+            gpiochip_info info{};
+            int ret = ::ioctl(fd, GPIO_GET_CHIPINFO_IOCTL, &info);
+            ::close(fd);
+            if (ret < 0)
+            {
+                log<level::ERR>("Skipping unreadable GPIO chip",
+                                entry("PATH=%s", path.c_str()));
+                continue;
+            }
+
+            GpioChip chip;
+            chip.label = info.label;
+            chip.path = path;
+            chip.ngpio = info.lines;
+
+            // Also allow the controller to be named by its device
+            chips.emplace(f.path().filename().string(), chip);
+
+            auto label = chip.label;
+            chips.emplace(std::move(label), std::move(chip));
         }
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Error scanning GPIO chips",
+                        entry("ERROR=%s", e.what()),
+                        entry("PATH=%s", root.c_str()));
+    }
+}
 
-        std::ifstream labelStream{path + "/label"};
-        std::string label;
-        labelStream >> label;
-
-        if (label == GPIO_BASE_LABEL_NAME)
+void GpioChips::scanSysfs() const
+{
+    // Index every /sys/class/gpio/gpiochip* directory by the value of
+    // its 'label' file, along with its 'base' and 'ngpio' values.
+    try
+    {
+        for (auto& f : fs::directory_iterator(root))
         {
-            uint32_t base;
+            std::string path{f.path()};
+            if (f.path().filename().string().find("gpiochip") != 0)
+            {
+                continue;
+            }
+
+            GpioChip chip;
+            chip.path = path;
+            std::ifstream labelStream{path + "/label"};
+            std::getline(labelStream, chip.label);
+
             std::ifstream baseStream{path + "/base"};
-            baseStream >> base;
-            return base;
+            baseStream >> chip.base;
+
+            std::ifstream ngpioStream{path + "/ngpio"};
+            ngpioStream >> chip.ngpio;
+
+            if (chip.label.empty() || baseStream.fail() || ngpioStream.fail())
+            {
+                log<level::ERR>("Skipping unreadable GPIO chip",
+                                entry("PATH=%s", path.c_str()));
+                continue;
+            }
+
+            auto label = chip.label;
+            chips.emplace(std::move(label), std::move(chip));
         }
     }
-
-    log<level::ERR>("Could not find GPIO base");
-    throw std::runtime_error("Could not find GPIO base!");
-#else
-    return 0;
-#endif
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Error scanning GPIO chips",
+                        entry("ERROR=%s", e.what()),
+                        entry("PATH=%s", root.c_str()));
+    }
 }
 
-uint32_t getGpioNum(const std::string& gpioPin)
+const GpioChip* GpioChips::find(const std::string& label) const
 {
-    // gpioplus promises that they will figure out how to easily
-    // support multiple BMC vendors when the time comes.
-    auto offset = gpioplus::utility::aspeed::nameToOffset(gpioPin);
+    scan();
 
-    return getGpioBase() + offset;
+    auto chip = chips.find(label);
+    if (chip == chips.end())
+    {
+        return nullptr;
+    }
+    return &chip->second;
 }
 
-bool gpioDefined(const std::string& gpioName)
+/**
+ * @brief Resolves a GPIO definition to its controller and the offset
+ *        of the line within it
+ *
+ * The controller is nullptr if the line uses the global sysfs
+ * numbering with a base of 0.
+ */
+static std::tuple<const GpioChip*, uint32_t>
+    resolveGpio(const GpioDefinition& gpio, const GpioChips& chips)
 {
-    try
+    uint32_t offset;
+    if (gpio.offset)
     {
-        std::ifstream gpios{gpioDefs};
-        auto json = nlohmann::json::parse(gpios, nullptr, true);
-        auto defs = json["gpio_definitions"];
+        offset = *gpio.offset;
+    }
+    else
+    {
+        // gpioplus promises that they will figure out how to easily
+        // support multiple BMC vendors when the time comes.
+        offset = gpioplus::utility::aspeed::nameToOffset(gpio.pin);
+    }
 
-        auto gpio =
-            std::find_if(defs.begin(), defs.end(), [&gpioName](const auto g) {
-                return gpioName == g["name"];
-            });
+    std::string label = gpio.chip;
+#ifdef LOOKUP_GPIO_BASE
+    if (label.empty())
+    {
+        label = GPIO_BASE_LABEL_NAME;
+    }
+#endif
+    if (label.empty())
+    {
+        if (chips.backend() == GpioBackend::cdev)
+        {
+            // Without a label the first controller is the default one
+            label = "gpiochip0";
+        }
+        else
+        {
+            return {nullptr, offset};
+        }
+    }
+
+    auto chip = chips.find(label);
+    if (!chip)
+    {
+        log<level::ERR>("Could not find GPIO chip",
+                        entry("LABEL=%s", label.c_str()));
+        throw std::runtime_error("Could not find GPIO chip!");
+    }
+
+    if (offset >= chip->ngpio)
+    {
+        log<level::ERR>("GPIO offset out of range for its chip",
+                        entry("LABEL=%s", label.c_str()),
+                        entry("OFFSET=%u", offset),
+                        entry("NGPIO=%u", chip->ngpio));
+        throw std::out_of_range("GPIO offset out of range!");
+    }
 
-        if (gpio != defs.end())
+    return {chip, offset};
+}
+
+/**
+ * @brief Reads the optional button keys of a GPIO definition
+ *
+ * A bad value is logged and leaves all of them at their defaults, the
+ * line itself is still usable.  hold_ms may be a single hold time or
+ * a list of them.
+ *
+ * @param[in] gpio - the JSON of the definition
+ * @param[in,out] def - the definition
+ */
+static void parseButtonKeys(const nlohmann::json& gpio, GpioDefinition& def)
+{
+    try
+    {
+        auto debounceMs = gpio.value("debounce_ms", def.debounceMs);
+        auto signalRate = gpio.value("signal_rate", def.signalRate);
+        auto signalBurst = gpio.value("signal_burst", def.signalBurst);
+        auto clickMs = gpio.value("click_ms", def.clickMs);
+
+        std::vector<uint32_t> holdMs;
+        auto hold = gpio.find("hold_ms");
+        if (hold != gpio.end())
         {
-            return true;
+            holdMs = hold->is_array() ? hold->get<std::vector<uint32_t>>()
+                                      : std::vector<uint32_t>{
+                                            hold->get<uint32_t>()};
         }
+
+        def.debounceMs = debounceMs;
+        def.signalRate = signalRate;
+        def.signalBurst = signalBurst;
+        def.holdMs = std::move(holdMs);
+        def.clickMs = clickMs;
     }
     catch (std::exception& e)
     {
-        log<level::ERR>("Error parsing GPIO JSON", entry("ERROR=%s", e.what()),
-                        entry("GPIO_NAME=%s", gpioName.c_str()));
+        log<level::ERR>("Bad button settings, using the defaults",
+                        entry("GPIO=%s", def.name.c_str()),
+                        entry("ERROR=%s", e.what()));
     }
-    return false;
 }
 
-std::optional<std::tuple<int, std::string>>
-    getGpioConfig(const std::string& gpioName)
+GpioDefinitions::GpioDefinitions(const std::string& path) :
+    gpioBackend(toGpioBackend(GPIO_BACKEND).value_or(GpioBackend::sysfs))
 {
-
     try
     {
-        std::ifstream gpios{gpioDefs};
+        std::ifstream gpios{path};
         auto json = nlohmann::json::parse(gpios, nullptr, true);
-        auto defs = json["gpio_definitions"];
+        const auto& gpioDefs = json.at("gpio_definitions");
 
-        auto gpio =
-            std::find_if(defs.begin(), defs.end(), [&gpioName](const auto g) {
-                return gpioName == g["name"];
-            });
+        auto backendName = json.value("gpio_backend", "");
+        if (!backendName.empty())
+        {
+            auto backend = toGpioBackend(backendName);
+            if (!backend)
+            {
+                log<level::ERR>("Unknown GPIO backend, using the default",
+                                entry("BACKEND=%s", backendName.c_str()));
+            }
+            gpioBackend = backend.value_or(gpioBackend);
+        }
 
-        if (gpio != defs.end())
+        defs.reserve(gpioDefs.size());
+        for (const auto& gpio : gpioDefs)
         {
-            return std::make_tuple(getGpioNum((*gpio)["pin"]),
-                                   (*gpio)["direction"]);
+            GpioDefinition def;
+            def.name = gpio.at("name").get<std::string>();
+            def.pin = gpio.value("pin", "");
+            def.direction = gpio.value("direction", "");
+            def.chip = gpio.value("chip", "");
+            auto offset = gpio.find("offset");
+            if (offset != gpio.end())
+            {
+                def.offset = offset->get<uint32_t>();
+            }
+            parseButtonKeys(gpio, def);
+
+            auto name = def.name;
+            defs.emplace(std::move(name), std::move(def));
         }
-        else
+
+        // The optional arrays are checked one entry at a time, so a bad
+        // entry doesn't take the GPIO definitions with it
+        auto buttons = json.find("buttons");
+        if (buttons != json.end() && buttons->is_array())
+        {
+            for (const auto& button : *buttons)
+            {
+                try
+                {
+                    ButtonDefinition def;
+                    def.type = button.at("type").get<std::string>();
+                    def.gpio = button.at("gpio").get<std::string>();
+                    def.index = button.value("index", 0u);
+                    def.path = button.value("path", "");
+                    buttonDefs.push_back(std::move(def));
+                }
+                catch (std::exception& e)
+                {
+                    log<level::ERR>("Bad button definition, skipped",
+                                    entry("ERROR=%s", e.what()),
+                                    entry("PATH=%s", path.c_str()));
+                }
+            }
+        }
+
+        auto chords = json.find("chords");
+        if (chords != json.end() && chords->is_array())
         {
-            log<level::ERR>("Unable to find GPIO in the definitions",
-                            entry("GPIO_NAME=%s", gpioName.c_str()));
+            for (const auto& chord : *chords)
+            {
+                try
+                {
+                    ChordDefinition def;
+                    def.name = chord.at("name").get<std::string>();
+                    def.gpios =
+                        chord.at("gpios").get<std::vector<std::string>>();
+                    def.holdMs = chord.value("hold_ms", 0u);
+                    chordDefs.push_back(std::move(def));
+                }
+                catch (std::exception& e)
+                {
+                    log<level::ERR>("Bad chord definition, skipped",
+                                    entry("ERROR=%s", e.what()),
+                                    entry("PATH=%s", path.c_str()));
+                }
+            }
         }
     }
     catch (std::exception& e)
     {
         log<level::ERR>("Error parsing GPIO JSON", entry("ERROR=%s", e.what()),
-                        entry("GPIO_NAME=%s", gpioName.c_str()));
+                        entry("PATH=%s", path.c_str()));
+        defs.clear();
+        buttonDefs.clear();
+        chordDefs.clear();
     }
-    return {};
 }
 
-int configGpio(const char* gpioName, int* fd, sdbusplus::bus::bus& bus)
+const GpioDefinition*
+    GpioDefinitions::find(const std::string& gpioName) const
 {
-    auto config = getGpioConfig(gpioName);
-    if (!config)
+    auto gpio = defs.find(gpioName);
+    if (gpio == defs.end())
     {
-        return -1;
+        return nullptr;
     }
+    return &gpio->second;
+}
 
-    auto [gpioNum, gpioDirection] = *config;
+/**
+ * @class ScopedFd
+ *
+ * Closes a file descriptor when it goes out of scope.
+ */
+class ScopedFd
+{
+  public:
+    explicit ScopedFd(int fd = -1) : fd(fd)
+    {
+    }
+    ~ScopedFd()
+    {
+        reset();
+    }
+    ScopedFd(const ScopedFd&) = delete;
+    ScopedFd& operator=(const ScopedFd&) = delete;
 
-    std::string devPath{gpioDev};
+    int get() const
+    {
+        return fd;
+    }
 
-    std::fstream stream;
+    void reset(int newFd = -1)
+    {
+        if (fd >= 0)
+        {
+            ::close(fd);
+        }
+        fd = newFd;
+    }
 
-    stream.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+    int release()
+    {
+        int released = fd;
+        fd = -1;
+        return released;
+    }
 
-    devPath += "/gpio" + std::to_string(gpioNum) + "/value";
+  private:
+    int fd;
+};
+
+/**
+ * @brief Writes a sysfs attribute of a GPIO, unless it already holds
+ *        the value or the one to keep
+ *
+ * Reconfiguring a line can glitch it, and the attributes are set
+ * again every time a button is brought up, e.g. on a sled hot plug.
+ *
+ * @param[in] dirFd - the gpioN directory
+ * @param[in] name - the attribute name
+ * @param[in] value - the value to write
+ * @param[in] keep - another value to leave alone, may be nullptr
+ *
+ * @return 0, or a negative errno
+ */
+static int setAttribute(int dirFd, const char* name, const char* value,
+                        const char* keep = nullptr)
+{
+    ScopedFd fd{::openat(dirFd, name, O_RDWR | O_CLOEXEC)};
+    if (fd.get() < 0)
+    {
+        return -errno;
+    }
 
-    fs::path fullPath(devPath);
+    std::array<char, 16> current;
+    auto n = ::pread(fd.get(), current.data(), current.size(), 0);
+    if (n > 0 && current[n - 1] == '\n')
+    {
+        n--;
+    }
 
-    if (fs::exists(fullPath))
+    for (auto unchanged : {value, keep})
     {
-        log<level::INFO>("GPIO exported", entry("PATH=%s", devPath.c_str()));
+        if (unchanged && n == static_cast<ssize_t>(std::strlen(unchanged)) &&
+            std::memcmp(current.data(), unchanged, n) == 0)
+        {
+            return 0;
+        }
     }
-    else
+
+    size_t len = std::strlen(value);
+    if (::pwrite(fd.get(), value, len, 0) != static_cast<ssize_t>(len))
     {
-        devPath = gpioDev + "/export";
+        return -errno;
+    }
+    return 0;
+}
+
+/**
+ * @brief Exports and configures a GPIO through sysfs and opens its
+ *        value file
+ *
+ * The gpioN directory is opened once and the attributes are set
+ * relative to it.  The value file is read once, which both gives
+ * the level an output keeps and primes the edge notification of an
+ * input, so the caller must not read it again before polling.
+ *
+ * @param[in] gpioDev - the sysfs GPIO directory, /sys/class/gpio
+ *                      unless a test tree is used
+ */
+static int configSysfsGpio(const std::string& gpioDev, uint32_t gpioNum,
+                           const std::string& gpioDirection, int* fd)
+{
+    auto num = std::to_string(gpioNum);
+    auto gpioPath = gpioDev + "/gpio" + num;
 
-        stream.open(devPath, std::fstream::out);
-        try
+    ScopedFd dirFd{
+        ::open(gpioPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC)};
+    if (dirFd.get() >= 0)
+    {
+        log<level::INFO>("GPIO exported", entry("PATH=%s", gpioPath.c_str()));
+    }
+    else
+    {
+        auto exportPath = gpioDev + "/export";
+        ScopedFd exportFd{::open(exportPath.c_str(), O_WRONLY | O_CLOEXEC)};
+        if (exportFd.get() < 0 ||
+            ::write(exportFd.get(), num.data(), num.size()) < 0)
         {
-            stream << gpioNum;
-            stream.close();
+            log<level::ERR>("Error in writing!",
+                            entry("PATH=%s", exportPath.c_str()),
+                            entry("NUM=%u", gpioNum));
+            return -1;
         }
 
-        catch (const std::exception& e)
+        dirFd.reset(
+            ::open(gpioPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+        if (dirFd.get() < 0)
         {
-            log<level::ERR>("Error in writing!",
-                            entry("PATH=%s", devPath.c_str()),
-                            entry("NUM=%d", gpioNum));
+            log<level::ERR>("open error!", entry("PATH=%s", gpioPath.c_str()));
             return -1;
         }
     }
 
-    if (gpioDirection == "out")
+    ScopedFd valueFd{
+        ::openat(dirFd.get(), "value", O_RDWR | O_NONBLOCK | O_CLOEXEC)};
+    if (valueFd.get() < 0)
     {
-        devPath = gpioDev + "/gpio" + std::to_string(gpioNum) + "/value";
-
-        uint32_t currentValue;
-
-        stream.open(devPath, std::fstream::in);
-        try
-        {
-            stream >> currentValue;
-            stream.close();
-        }
+        log<level::ERR>("open error!", entry("PATH=%s", gpioPath.c_str()));
+        return -1;
+    }
 
-        catch (const std::exception& e)
+    int ret = 0;
+    char level = '0';
+    if (gpioDirection == "out")
+    {
+        if (::pread(valueFd.get(), &level, sizeof(level), 0) < 0)
         {
             log<level::ERR>("Error in reading!",
-                            entry("PATH=%s", devPath.c_str()));
+                            entry("PATH=%s", gpioPath.c_str()));
             return -1;
         }
 
-        const char* direction = currentValue ? "high" : "low";
-
-        devPath.clear();
-        devPath = gpioDev + "/gpio" + std::to_string(gpioNum) + "/direction";
+        // An output keeps its level, whether it is already one or not
+        ret = setAttribute(dirFd.get(), "direction",
+                           (level == '0') ? "low" : "high", "out");
+    }
+    else if (gpioDirection == "in")
+    {
+        ret = setAttribute(dirFd.get(), "direction", "in");
+    }
+    else if (gpioDirection == "both")
+    {
+        // Before set gpio configure as an interrupt pin, need to set direction
+        // as 'in' or edge can't set as 'rising', 'falling' and 'both'
+        ret = setAttribute(dirFd.get(), "direction", "in");
 
-        stream.open(devPath, std::fstream::out);
-        try
+        // For gpio configured as 'both', it is an interrupt pin and trigged on
+        // both rising and falling signals
+        if (ret == 0)
         {
-            stream << direction;
-            stream.close();
+            ret = setAttribute(dirFd.get(), "edge", "both");
         }
 
-        catch (const std::exception& e)
+        // Consume the initial level so only later edges are reported
+        if (ret == 0 && ::pread(valueFd.get(), &level, sizeof(level), 0) < 0)
         {
-            log<level::ERR>("Error in writing!");
-            return -1;
+            ret = -errno;
         }
     }
-    else if (gpioDirection == "in")
+
+    if (ret < 0)
     {
-        devPath = gpioDev + "/gpio" + std::to_string(gpioNum) + "/direction";
+        log<level::ERR>("Error in writing!", entry("PATH=%s", gpioPath.c_str()),
+                        entry("ERRNO=%d", -ret));
+        return -1;
+    }
+
+    *fd = valueFd.release();
+    return 0;
+}
+
+namespace
+{
+
+/**
+ * @class SysfsGpioLine
+ *
+ * A GPIO exported through /sys/class/gpio.  Every wakeup is turned
+ * into a single event carrying the level read back from the value
+ * file and the time it was read.
+ */
+class SysfsGpioLine : public GpioLine
+{
+  public:
+    // configSysfsGpio() already consumed the initial level
+    explicit SysfsGpioLine(int fd) : valueFd(fd)
+    {
+    }
+
+    ~SysfsGpioLine()
+    {
+        closeGpio(valueFd);
+    }
 
-        stream.open(devPath, std::fstream::out);
-        try
+    int fd() const override
+    {
+        return valueFd;
+    }
+
+    uint32_t pollEvents() const override
+    {
+        return EPOLLPRI;
+    }
+
+    int readEvents(GpioEvent* events, size_t max) override
+    {
+        char buf = '0';
+
+        if (max == 0)
         {
-            stream << gpioDirection;
-            stream.close();
+            return 0;
         }
 
-        catch (const std::exception& e)
+        if (::lseek(valueFd, 0, SEEK_SET) < 0)
         {
-            log<level::ERR>("Error in writing!");
-            return -1;
+            return -errno;
         }
+
+        if (::read(valueFd, &buf, sizeof(buf)) < 0)
+        {
+            return -errno;
+        }
+
+        events[0].timestamp = monotonicNow();
+        events[0].seqno = 0;
+        events[0].value = (buf == '0') ? 0 : 1;
+        return 1;
     }
-    else if ((gpioDirection == "both"))
+
+  private:
+    int valueFd;
+};
+
+/**
+ * @class CdevGpioLine
+ *
+ * A GPIO requested through the GPIO v2 character device uAPI.
+ * The kernel queues the edges along with their direction, a
+ * CLOCK_MONOTONIC timestamp and a sequence number, so a single
+ * read returns every edge since the last wakeup.
+ */
+class CdevGpioLine : public GpioLine
+{
+  public:
+    explicit CdevGpioLine(int fd) : lineFd(fd)
     {
-        // Before set gpio configure as an interrupt pin, need to set direction
-        // as 'in' or edge can't set as 'rising', 'falling' and 'both'
-        const char* in_direction = "in";
-        devPath = gpioDev + "/gpio" + std::to_string(gpioNum) + "/direction";
+    }
+
+    ~CdevGpioLine()
+    {
+        closeGpio(lineFd);
+    }
+
+    int fd() const override
+    {
+        return lineFd;
+    }
+
+    uint32_t pollEvents() const override
+    {
+        return EPOLLIN;
+    }
+
+    int readEvents(GpioEvent* events, size_t max) override
+    {
+        std::array<gpio_v2_line_event, maxGpioEvents> buf;
+        size_t count = std::min(max, buf.size());
 
-        stream.open(devPath, std::fstream::out);
-        try
+        auto n = ::read(lineFd, buf.data(), count * sizeof(buf[0]));
+        if (n < 0)
         {
-            stream << in_direction;
-            stream.close();
+            return (errno == EAGAIN) ? 0 : -errno;
         }
 
-        catch (const std::exception& e)
+        count = n / sizeof(buf[0]);
+        for (size_t i = 0; i < count; i++)
         {
-            log<level::ERR>("Error in writing!");
-            return -1;
+            events[i].timestamp = buf[i].timestamp_ns;
+            events[i].seqno = buf[i].line_seqno;
+            events[i].value =
+                (buf[i].id == GPIO_V2_LINE_EVENT_RISING_EDGE) ? 1 : 0;
         }
-        devPath.clear();
+        return count;
+    }
 
-        // For gpio configured as ‘both’, it is an interrupt pin and trigged on
-        // both rising and falling signals
-        devPath = gpioDev + "/gpio" + std::to_string(gpioNum) + "/edge";
+  private:
+    int lineFd;
+};
+
+} // namespace
+
+/**
+ * @brief Requests a GPIO line from its /dev/gpiochipN device
+ */
+static int configCdevGpio(const GpioChip& chip, uint32_t offset,
+                          const std::string& gpioDirection, int* fd)
+{
+    gpio_v2_line_request req{};
+    req.offsets[0] = offset;
+    req.num_lines = 1;
+    std::strncpy(req.consumer, "buttons", sizeof(req.consumer) - 1);
+    req.config.flags = GPIO_V2_LINE_FLAG_INPUT;
+
+    // For gpio configured as 'both', it is an interrupt pin and
+    // trigged on both rising and falling signals
+    if (gpioDirection == "both")
+    {
+        req.config.flags |=
+            GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
+    }
+
+    int chipFd = ::open(chip.path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (chipFd < 0)
+    {
+        log<level::ERR>("open error!", entry("PATH=%s", chip.path.c_str()));
+        return -1;
+    }
+
+    int ret = ::ioctl(chipFd, GPIO_V2_GET_LINE_IOCTL, &req);
+    ::close(chipFd);
+    if (ret < 0)
+    {
+        log<level::ERR>("Error requesting GPIO line",
+                        entry("PATH=%s", chip.path.c_str()),
+                        entry("OFFSET=%u", offset),
+                        entry("ERRNO=%d", errno));
+        return -1;
+    }
 
-        stream.open(devPath, std::fstream::out);
-        try
+    if (gpioDirection == "out")
+    {
+        // Keep the current level when switching the line to an output
+        gpio_v2_line_values values{};
+        values.mask = 1;
+        if (::ioctl(req.fd, GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0)
         {
-            stream << gpioDirection;
-            stream.close();
+            log<level::ERR>("Error in reading!",
+                            entry("PATH=%s", chip.path.c_str()));
+            ::close(req.fd);
+            return -1;
         }
 
-        catch (const std::exception& e)
+        gpio_v2_line_config config{};
+        config.flags = GPIO_V2_LINE_FLAG_OUTPUT;
+        config.num_attrs = 1;
+        config.attrs[0].attr.id = GPIO_V2_LINE_ATTR_ID_OUTPUT_VALUES;
+        config.attrs[0].attr.values = values.bits;
+        config.attrs[0].mask = 1;
+        if (::ioctl(req.fd, GPIO_V2_LINE_SET_CONFIG_IOCTL, &config) < 0)
         {
-            log<level::ERR>("Error in writing!");
+            log<level::ERR>("Error in writing!",
+                            entry("PATH=%s", chip.path.c_str()));
+            ::close(req.fd);
             return -1;
         }
     }
 
-    devPath = gpioDev + "/gpio" + std::to_string(gpioNum) + "/value";
-
-    *fd = ::open(devPath.c_str(), O_RDWR | O_NONBLOCK);
-
-    if (*fd < 0)
+    int flags = ::fcntl(req.fd, F_GETFL);
+    if (flags < 0 || ::fcntl(req.fd, F_SETFL, flags | O_NONBLOCK) < 0)
     {
-        log<level::ERR>("open error!");
+        log<level::ERR>("Error making GPIO line non-blocking");
+        ::close(req.fd);
         return -1;
     }
 
+    *fd = req.fd;
     return 0;
 }
+
+std::unique_ptr<GpioLine> configGpio(const GpioDefinitions& defs,
+                                     const GpioChips& chips,
+                                     const std::string& gpioName)
+{
+    auto gpio = defs.find(gpioName);
+    if (!gpio)
+    {
+        log<level::ERR>("Unable to find GPIO in the definitions",
+                        entry("GPIO_NAME=%s", gpioName.c_str()));
+        return nullptr;
+    }
+
+    try
+    {
+        auto [chip, offset] = resolveGpio(*gpio, chips);
+        int fd = -1;
+
+        if (chips.backend() == GpioBackend::cdev)
+        {
+            if (configCdevGpio(*chip, offset, gpio->direction, &fd) < 0)
+            {
+                return nullptr;
+            }
+            return std::make_unique<CdevGpioLine>(fd);
+        }
+
+        uint32_t gpioNum = chip ? chip->base + offset : offset;
+        if (configSysfsGpio(chips.path(), gpioNum, gpio->direction, &fd) < 0)
+        {
+            return nullptr;
+        }
+        return std::make_unique<SysfsGpioLine>(fd);
+    }
+    catch (std::exception& e)
+    {
+        log<level::ERR>("Error configuring GPIO", entry("ERROR=%s", e.what()),
+                        entry("GPIO_NAME=%s", gpioName.c_str()));
+    }
+    return nullptr;
+}
@@ -14,17 +14,279 @@
 // limitations under the License.
 */
 
+#include "button_chords.hpp"
+#include "edge_capture.hpp"
+#include "flight_recorder.hpp"
 #include "id_button.hpp"
 #include "power_button.hpp"
 #include "reset_button.hpp"
+#include "settings.hpp"
+
+#ifdef IN_PROCESS_HANDLER
+#include "button_handler.hpp"
+#endif
+
+#include <getopt.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <phosphor-logging/log.hpp>
+#include <sdbusplus/server/manager.hpp>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using ButtonFactory = std::unique_ptr<ButtonBase> (*)(
+    sdbusplus::bus::bus& bus, const std::string& path, EventPtr& event,
+    const GpioDefinitions& gpioDefs, std::unique_ptr<GpioLine> line,
+    const std::string& gpioName);
+
+/**
+ * @brief What main needs to know to create a button of some type
+ */
+struct ButtonType
+{
+    const char* type;
+    const char* gpioName;
+    const char* objectPath;
+    ButtonFactory create;
+};
+
+template <typename T>
+constexpr ButtonType buttonType()
+{
+    using Traits = typename T::ButtonTraits;
+    return {Traits::type, Traits::gpioName, Traits::objectPath,
+            [](sdbusplus::bus::bus& bus, const std::string& path,
+               EventPtr& event, const GpioDefinitions& gpioDefs,
+               std::unique_ptr<GpioLine> line,
+               const std::string& gpioName) -> std::unique_ptr<ButtonBase> {
+                return std::make_unique<T>(bus, path.c_str(), event, gpioDefs,
+                                           std::move(line), gpioName);
+            }};
+}
+
+static constexpr std::array<ButtonType, 3> buttonTypes = {
+    buttonType<PowerButton>(), buttonType<ResetButton>(),
+    buttonType<IDButton>()};
+
+/**
+ * @brief Returns the button instances to create
+ *
+ * Without a buttons array in the config file there is one instance,
+ * number 0, of every button type whose default GPIO is defined.
+ */
+static std::vector<ButtonDefinition>
+    getButtonDefinitions(const GpioDefinitions& gpioDefs)
+{
+    if (!gpioDefs.buttons().empty())
+    {
+        return gpioDefs.buttons();
+    }
+
+    std::vector<ButtonDefinition> defs;
+    for (const auto& type : buttonTypes)
+    {
+        if (gpioDefs.contains(type.gpioName))
+        {
+            ButtonDefinition def;
+            def.type = type.type;
+            def.gpio = type.gpioName;
+            defs.push_back(std::move(def));
+        }
+    }
+    return defs;
+}
+
+/**
+ * @brief A button whose GPIO line is being configured
+ */
+struct PendingButton
+{
+    const ButtonType* type;
+    std::string path;
+    std::string gpioName;
+    std::future<std::unique_ptr<GpioLine>> line;
+};
+
+/**
+ * @brief Configures a GPIO line on a thread of its own
+ *
+ * The eventfd is signaled once the line is ready, so the event loop
+ * can run until then.  If no thread can be started the line is
+ * configured right away.
+ *
+ * @param[in] gpioDefs - the GPIO definitions
+ * @param[in] gpioChips - the GPIO controller index
+ * @param[in] gpioName - the GPIO name
+ * @param[in] readyFd - the eventfd to signal
+ * @param[out] workers - the thread is added here, to be joined
+ *
+ * @return the line, or nullptr if it can't be configured
+ */
+static std::future<std::unique_ptr<GpioLine>>
+    configGpioAsync(const GpioDefinitions& gpioDefs,
+                    const GpioChips& gpioChips, const std::string& gpioName,
+                    int readyFd, std::vector<std::thread>& workers)
+{
+    auto promise = std::make_shared<std::promise<std::unique_ptr<GpioLine>>>();
+    auto line = promise->get_future();
+    auto config = [&gpioDefs, &gpioChips, gpioName, readyFd, promise]() {
+        try
+        {
+            promise->set_value(configGpio(gpioDefs, gpioChips, gpioName));
+        }
+        catch (...)
+        {
+            promise->set_exception(std::current_exception());
+        }
+
+        // Only once the line is ready, so the loop finds it when it
+        // wakes up
+        uint64_t one = 1;
+        if (write(readyFd, &one, sizeof(one)) < 0)
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                "Failed to signal a configured GPIO line",
+                phosphor::logging::entry("ERRNO=%d", errno));
+        }
+    };
+
+    try
+    {
+        workers.emplace_back(config);
+    }
+    catch (const std::system_error& e)
+    {
+        config();
+    }
+    return line;
+}
+
+static int drainReady(sd_event_source* es, int fd, uint32_t revents,
+                      void* userdata)
+{
+    uint64_t count;
+    if (read(fd, &count, sizeof(count)) < 0 && errno != EAGAIN)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            "Failed to read the GPIO line eventfd",
+            phosphor::logging::entry("ERRNO=%d", errno));
+    }
+    return 0;
+}
+
+using StartupClock = std::chrono::steady_clock;
+
+/**
+ * @brief Logs how long a startup phase took and starts the next one
+ */
+static void phaseDone(const char* phase, StartupClock::time_point& start)
+{
+    auto now = StartupClock::now();
+    auto usec =
+        std::chrono::duration_cast<std::chrono::microseconds>(now - start);
+    phosphor::logging::log<phosphor::logging::level::INFO>(
+        "Startup phase done", phosphor::logging::entry("PHASE=%s", phase),
+        phosphor::logging::entry("USEC=%lld",
+                                 static_cast<long long>(usec.count())));
+    start = now;
+}
+
+static int dumpFlightRecorder(sd_event_source* es,
+                              const struct signalfd_siginfo* si, void* userdata)
+{
+    flightRecorder().dump();
+    return 0;
+}
+
+static void usage(const char* name)
+{
+    std::cerr << "Usage: " << name << " [options]\n"
+              << "  --gpio-defs <file>  GPIO definitions, default "
+              << gpioDefsFile << "\n"
+              << "  --gpio-root <dir>   Directory of the GPIO controllers, "
+                 "default "
+              << gpioSysfsRoot << " or " << gpioCdevRoot << "\n"
+              << "  --record <file>     Record the edges of every button "
+                 "to a trace\n"
+              << "  --capture           Read the GPIO lines on a thread of "
+                 "their own\n"
+              << "  --capture-priority <prio>\n"
+              << "                      SCHED_FIFO priority of the capture "
+                 "thread\n"
+              << "  --capture-cpu <cpu> CPU to pin the capture thread to\n";
+}
 
 int main(int argc, char* argv[])
 {
     int ret = 0;
 
+    // The paths can be pointed at a test tree, to try the GPIO setup
+    // off target.  epoll refuses regular files, so no edges are seen
+    // there, button_bench feeds them through pipes instead.
+    std::string gpioDefsPath{gpioDefsFile};
+    std::string gpioRoot;
+    std::string tracePath;
+    bool captureEdges = false;
+    CaptureConfig captureConfig;
+
+    static const option options[] = {
+        {"gpio-defs", required_argument, nullptr, 'd'},
+        {"gpio-root", required_argument, nullptr, 'r'},
+        {"record", required_argument, nullptr, 't'},
+        {"capture", no_argument, nullptr, 'c'},
+        {"capture-priority", required_argument, nullptr, 'p'},
+        {"capture-cpu", required_argument, nullptr, 'a'},
+        {nullptr, 0, nullptr, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "d:r:t:cp:a:", options,
+                              nullptr)) != -1)
+    {
+        switch (opt)
+        {
+            case 'd':
+                gpioDefsPath = optarg;
+                break;
+            case 'r':
+                gpioRoot = optarg;
+                break;
+            case 't':
+                tracePath = optarg;
+                break;
+            case 'c':
+                captureEdges = true;
+                break;
+            case 'p':
+                captureConfig.priority = std::atoi(optarg);
+                break;
+            case 'a':
+                captureConfig.cpu = std::atoi(optarg);
+                break;
+            default:
+                usage(argv[0]);
+                return -1;
+        }
+    }
+
     phosphor::logging::log<phosphor::logging::level::INFO>(
         "Start power button service...");
 
+    auto startupStart = StartupClock::now();
+    auto phaseStart = startupStart;
+
     sd_event* event = nullptr;
     ret = sd_event_default(&event);
     if (ret < 0)
@@ -36,33 +298,225 @@ int main(int argc, char* argv[])
     EventPtr eventP{event};
     event = nullptr;
 
+    // SIGUSR1 writes the recent button events out to the journal
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    sigprocmask(SIG_BLOCK, &mask, nullptr);
+    ret = sd_event_add_signal(eventP.get(), nullptr, SIGUSR1,
+                              dumpFlightRecorder, nullptr);
+    if (ret < 0)
+    {
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            "Failed to add the flight recorder signal handler",
+            phosphor::logging::entry("RET=%d", ret));
+    }
+
     sdbusplus::bus::bus bus = sdbusplus::bus::new_default();
     sdbusplus::server::manager::manager objManager{
         bus, "/xyz/openbmc_project/Chassis/Buttons"};
 
+    // Claim the name before touching any hardware, and serve the bus
+    // from the loop from here on, so the object manager answers while
+    // the lines come up and the buttons appear under it one by one
     bus.request_name("xyz.openbmc_project.Chassis.Buttons");
+    bus.attach_event(eventP.get(), SD_EVENT_PRIORITY_NORMAL);
+    phaseDone("bus", phaseStart);
+
+    // Parse the GPIO definitions once and share them, along with the
+    // GPIO controller index, with every button
+    GpioDefinitions gpioDefs{gpioDefsPath};
+    GpioChips gpioChips{gpioDefs.backend(), gpioRoot};
+    gpioChips.scan();
+    phaseDone("config", phaseStart);
+
+    // Record the edges for a later replay, if asked to
+    std::unique_ptr<TraceWriter> trace;
+    if (!tracePath.empty())
+    {
+        try
+        {
+            trace = std::make_unique<TraceWriter>(tracePath);
+            for (const auto& chord : gpioDefs.chords())
+            {
+                trace->addChord(chord);
+            }
+        }
+        catch (std::exception& e)
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                "Failed to start recording",
+                phosphor::logging::entry("ERROR=%s", e.what()));
+        }
+    }
 
-    std::unique_ptr<PowerButton> pb;
-    if (hasGpio<PowerButton>())
+#ifdef IN_PROCESS_HANDLER
+    // The handler acts on the actions of the buttons directly, their
+    // signals still go out for anyone else listening
+    phosphor::button::Handler handler{bus, true};
+#endif
+
+    // The chords outlive the buttons that report to them
+    std::unique_ptr<ButtonChords> chords;
+    if (!gpioDefs.chords().empty())
     {
-        pb = std::make_unique<PowerButton>(bus, POWER_DBUS_OBJECT_NAME, eventP);
+        try
+        {
+            chords =
+                std::make_unique<ButtonChords>(bus, eventP, gpioDefs.chords());
+        }
+        catch (std::exception& e)
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                "Failed to set up the button chords",
+                phosphor::logging::entry("ERROR=%s", e.what()));
+        }
     }
 
-    std::unique_ptr<ResetButton> rb;
-    if (hasGpio<ResetButton>())
+    // Configure the lines of all buttons at once, so the sysfs writes
+    // and opens of one don't wait for those of the others.  Each one
+    // wakes the loop up when it is ready.
+    sd_event_source* readySource = nullptr;
+    int readyFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (readyFd < 0 ||
+        sd_event_add_io(eventP.get(), &readySource, readyFd, EPOLLIN,
+                        drainReady, nullptr) < 0)
     {
-        rb = std::make_unique<ResetButton>(bus, RESET_DBUS_OBJECT_NAME, eventP);
+        phosphor::logging::log<phosphor::logging::level::ERR>(
+            "Failed to watch the GPIO line setup");
+        if (readyFd >= 0)
+        {
+            close(readyFd);
+        }
+        return -1;
     }
+    sd_event_source_set_io_fd_own(readySource, 1);
 
-    std::unique_ptr<IDButton> ib;
-    if (hasGpio<IDButton>())
+    std::vector<PendingButton> pending;
+    std::vector<std::thread> workers;
+    for (const auto& def : getButtonDefinitions(gpioDefs))
     {
-        ib = std::make_unique<IDButton>(bus, ID_DBUS_OBJECT_NAME, eventP);
+        auto type = std::find_if(
+            buttonTypes.begin(), buttonTypes.end(),
+            [&def](const auto& t) { return def.type == t.type; });
+        if (type == buttonTypes.end())
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                "Unknown button type",
+                phosphor::logging::entry("TYPE=%s", def.type.c_str()));
+            continue;
+        }
+
+        auto path = def.path;
+        if (path.empty())
+        {
+            path = type->objectPath + std::to_string(def.index);
+        }
+
+        auto line = configGpioAsync(gpioDefs, gpioChips, def.gpio, readyFd,
+                                    workers);
+        pending.push_back({&*type, path, def.gpio, std::move(line)});
+    }
+
+    // All button instances are served from this one event loop, each
+    // one created as soon as its line is ready
+    std::vector<std::unique_ptr<ButtonBase>> buttons;
+    for (size_t left = pending.size(); left;)
+    {
+        for (auto& button : pending)
+        {
+            if (!button.line.valid() ||
+                button.line.wait_for(std::chrono::seconds(0)) !=
+                    std::future_status::ready)
+            {
+                continue;
+            }
+            left--;
+
+            try
+            {
+                buttons.push_back(button.type->create(
+                    bus, button.path, eventP, gpioDefs, button.line.get(),
+                    button.gpioName));
+                if (trace)
+                {
+                    buttons.back()->recordTo(*trace);
+                }
+                if (chords)
+                {
+                    buttons.back()->chordWith(*chords);
+                }
+#ifdef IN_PROCESS_HANDLER
+                buttons.back()->forwardTo(
+                    [&handler, type = std::string{button.type->type},
+                     path = button.path](ButtonAction action) {
+                        handler.buttonAction(type, path, action);
+                    });
+#endif
+            }
+            catch (std::exception& e)
+            {
+                phosphor::logging::log<phosphor::logging::level::ERR>(
+                    "Failed to create button",
+                    phosphor::logging::entry("PATH=%s", button.path.c_str()),
+                    phosphor::logging::entry("GPIO_NAME=%s",
+                                             button.gpioName.c_str()));
+            }
+        }
+
+        if (left && sd_event_run(eventP.get(), UINT64_MAX) < 0)
+        {
+            // Without the loop, wait for the rest of the lines here
+            for (auto& button : pending)
+            {
+                if (button.line.valid())
+                {
+                    button.line.wait();
+                }
+            }
+        }
+    }
+    for (auto& worker : workers)
+    {
+        worker.join();
+    }
+    sd_event_source_unref(readySource);
+    phaseDone("buttons", phaseStart);
+
+    // Read the lines on a thread of their own, if asked to, so D-Bus
+    // traffic on the loop can't delay them.  It is stopped before the
+    // buttons go away.
+    std::unique_ptr<EdgeCapture> capture;
+    if (captureEdges)
+    {
+        try
+        {
+            capture = std::make_unique<EdgeCapture>(eventP, captureConfig);
+            capture->start();
+        }
+        catch (std::exception& e)
+        {
+            phosphor::logging::log<phosphor::logging::level::ERR>(
+                "Failed to start the capture thread, reading the lines "
+                "from the event loop",
+                phosphor::logging::entry("ERROR=%s", e.what()));
+            capture.reset();
+        }
+    }
+
+    // Only a running thread takes the lines over
+    if (capture)
+    {
+        for (auto& button : buttons)
+        {
+            button->captureWith(*capture);
+        }
     }
+    phaseDone("capture", phaseStart);
+    phaseDone("total", startupStart);
 
     try
     {
-        bus.attach_event(eventP.get(), SD_EVENT_PRIORITY_NORMAL);
         ret = sd_event_loop(eventP.get());
         if (ret < 0)
         {
@@ -16,12 +16,7 @@
 
 #include "power_button.hpp"
 
-void PowerButton::simPress()
-{
-    pressed();
-}
-
 void PowerButton::simLongPress()
 {
-    pressedLong();
+    deliver(ButtonAction::pressedLong);
 }
@@ -14,11 +14,25 @@
 // limitations under the License.
 */
 
-#include "reset_button.hpp"
+#include "timer.hpp"
 
-#include "xyz/openbmc_project/Chassis/Buttons/Reset/server.hpp"
+Timer::Timer(EventPtr& event, Callback callback) :
+    wheel(TimerWheel::get(event.get()))
+{
+    entry.callback = std::move(callback);
+}
+
+Timer::~Timer()
+{
+    wheel->cancel(entry);
+}
+
+void Timer::arm(uint64_t deadline)
+{
+    wheel->arm(entry, deadline);
+}
 
-void ResetButton::simPress()
+void Timer::cancel()
 {
-    pressed();
+    wheel->cancel(entry);
 }
@@ -0,0 +1,308 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "timer_wheel.hpp"
+
+#include <time.h>
+
+#include <algorithm>
+#include <limits>
+#include <phosphor-logging/log.hpp>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace phosphor::logging;
+
+// Accuracy of the wheel wakeups, in microseconds
+static constexpr uint64_t timerAccuracy = 1000;
+
+/**
+ * @brief The current time of a loop, in nanoseconds
+ */
+static uint64_t loopNow(sd_event* loop)
+{
+    uint64_t usec = 0;
+    if (sd_event_now(loop, CLOCK_MONOTONIC, &usec) >= 0)
+    {
+        return usec * 1000;
+    }
+
+    // The loop hasn't run yet
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+std::shared_ptr<TimerWheel> TimerWheel::get(sd_event* loop)
+{
+    // The timers all live on the loop thread
+    static std::unordered_map<sd_event*, std::weak_ptr<TimerWheel>> wheels;
+
+    auto wheel = wheels[loop].lock();
+    if (!wheel)
+    {
+        wheel = std::make_shared<TimerWheel>(loop);
+        wheels[loop] = wheel;
+    }
+    return wheel;
+}
+
+TimerWheel::TimerWheel(sd_event* loop) : loop(loop)
+{
+    int ret = sd_event_add_time(loop, &source, CLOCK_MONOTONIC,
+                                std::numeric_limits<uint64_t>::max(),
+                                timerAccuracy, timeoutHandler, this);
+    if (ret < 0)
+    {
+        log<level::ERR>("Failed to add a timer to the event loop",
+                        entry("RET=%d", ret));
+        throw std::runtime_error("Failed to add timer");
+    }
+    sd_event_source_set_enabled(source, SD_EVENT_OFF);
+
+    now = loopNow(loop) / tickNs;
+}
+
+TimerWheel::~TimerWheel()
+{
+    sd_event_source_unref(source);
+}
+
+void TimerWheel::arm(Entry& entry, uint64_t deadline)
+{
+    if (entry.armed)
+    {
+        unlink(entry);
+    }
+    else if (!count)
+    {
+        // Nothing was due while the wheel was empty, so it can catch
+        // up with the loop without visiting any slot
+        now = std::max(now, loopNow(loop) / tickNs);
+    }
+
+    // Round up, a timer must never fire before its deadline
+    entry.tick = (deadline + tickNs - 1) / tickNs;
+    insert(entry);
+    schedule();
+}
+
+void TimerWheel::cancel(Entry& entry)
+{
+    if (entry.armed)
+    {
+        unlink(entry);
+        schedule();
+    }
+}
+
+void TimerWheel::insert(Entry& entry)
+{
+    // Past deadlines go in the current slot
+    auto tick = std::max(entry.tick, now);
+
+    Link* head = &overflow;
+    entry.level = levels;
+    entry.slot = 0;
+    if (!((tick ^ now) >> blockBits))
+    {
+        unsigned level = 0;
+        auto diff = tick ^ now;
+        while (level + 1 < levels && (diff >> (levelBits * (level + 1))))
+        {
+            level++;
+        }
+        auto slot = (tick >> (levelBits * level)) & slotMask;
+
+        head = &wheel[level][slot];
+        entry.level = level;
+        entry.slot = slot;
+        occupied[level] |= 1ULL << slot;
+    }
+
+    entry.prev = head->prev;
+    entry.next = head;
+    head->prev->next = &entry;
+    head->prev = &entry;
+    entry.armed = true;
+    count++;
+}
+
+void TimerWheel::unlink(Entry& entry)
+{
+    entry.prev->next = entry.next;
+    entry.next->prev = entry.prev;
+    entry.prev = entry.next = &entry;
+    entry.armed = false;
+    count--;
+
+    if (entry.level < levels)
+    {
+        auto& head = wheel[entry.level][entry.slot];
+        if (head.next == &head)
+        {
+            occupied[entry.level] &= ~(1ULL << entry.slot);
+        }
+    }
+}
+
+std::optional<uint64_t> TimerWheel::nextTick() const
+{
+    // Every timer of a level comes before those of the levels above,
+    // and only slots past the current one can be occupied, but for
+    // the current slot of level 0, which is due now
+    for (unsigned level = 0; level < levels; level++)
+    {
+        auto shift = levelBits * level;
+        auto index = (now >> shift) & slotMask;
+        auto mask = occupied[level];
+        if (level)
+        {
+            mask &= (index == slotMask) ? 0 : ~0ULL << (index + 1);
+        }
+        else
+        {
+            mask &= ~0ULL << index;
+        }
+
+        if (mask)
+        {
+            uint64_t slot = __builtin_ctzll(mask);
+            return (now >> (shift + levelBits) << (shift + levelBits)) |
+                   (slot << shift);
+        }
+    }
+
+    if (overflow.next != &overflow)
+    {
+        return ((now >> blockBits) + 1) << blockBits;
+    }
+    return std::nullopt;
+}
+
+void TimerWheel::run(uint64_t nowNs)
+{
+    running = true;
+    auto target = nowNs / tickNs;
+    for (;;)
+    {
+        auto next = nextTick();
+        if (!next || *next > target)
+        {
+            // No slot is passed over on the way
+            now = std::max(now, target);
+            break;
+        }
+        now = *next;
+
+        // The overflow is only waited for once the wheel is empty
+        // up to the end of its block
+        if (!(now & blockMask))
+        {
+            expire(overflow, false, nowNs);
+        }
+
+        // Move the timers of the slots just reached down a level, or
+        // take those due off level 0
+        for (unsigned level = levels; level-- > 0;)
+        {
+            auto slot = (now >> (levelBits * level)) & slotMask;
+            if (occupied[level] & (1ULL << slot))
+            {
+                occupied[level] &= ~(1ULL << slot);
+                expire(wheel[level][slot], !level, nowNs);
+            }
+        }
+    }
+    running = false;
+    schedule();
+}
+
+void TimerWheel::expire(Link& head, bool fire, uint64_t nowNs)
+{
+    // Detach the list, callbacks may arm and cancel timers
+    Link pending;
+    if (head.next == &head)
+    {
+        return;
+    }
+    pending.next = head.next;
+    pending.prev = head.prev;
+    pending.next->prev = &pending;
+    pending.prev->next = &pending;
+    head.prev = head.next = &head;
+
+    while (pending.next != &pending)
+    {
+        auto& entry = *static_cast<Entry*>(pending.next);
+        entry.prev->next = entry.next;
+        entry.next->prev = entry.prev;
+        entry.prev = entry.next = &entry;
+        entry.armed = false;
+        count--;
+
+        if (!fire || entry.tick > now)
+        {
+            insert(entry);
+        }
+        else
+        {
+            entry.callback(nowNs);
+        }
+    }
+}
+
+void TimerWheel::schedule()
+{
+    if (running)
+    {
+        return;
+    }
+
+    // Waking up too early is harmless, run() arms the source again for
+    // what is left, so cancelling timers or pushing them back doesn't
+    // need to touch the source unless the wheel is left empty
+    auto next = nextTick();
+    if (next == scheduled || (next && scheduled && *scheduled < *next))
+    {
+        return;
+    }
+
+    scheduled = next;
+    if (next)
+    {
+        sd_event_source_set_time(source, *next * (tickNs / 1000));
+        sd_event_source_set_enabled(source, SD_EVENT_ONESHOT);
+    }
+    else
+    {
+        sd_event_source_set_enabled(source, SD_EVENT_OFF);
+    }
+}
+
+int TimerWheel::timeoutHandler(sd_event_source* es, uint64_t usec,
+                               void* userdata)
+{
+    auto wheel = static_cast<TimerWheel*>(userdata);
+
+    // The source is one shot, it needs arming again
+    wheel->scheduled.reset();
+
+    uint64_t now = usec;
+    sd_event_now(sd_event_source_get_event(es), CLOCK_MONOTONIC, &now);
+    wheel->run(now * 1000);
+    return 0;
+}
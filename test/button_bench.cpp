@@ -0,0 +1,449 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gpio.hpp"
+#include "power_button.hpp"
+#include "sysfs_harness.hpp"
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sdbusplus/bus.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+using Clock = std::chrono::steady_clock;
+
+uint64_t monotonicNow()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+double msSince(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start)
+        .count();
+}
+
+/**
+ * @class PipeLine
+ *
+ * Stands in for a GPIO line: every byte written to the pipe is an
+ * edge to that level, read and timestamped like the cdev backend
+ * does, up to a batch per wakeup.
+ */
+class PipeLine : public GpioLine
+{
+  public:
+    PipeLine(int fd, size_t batch) : readFd(fd), batch(batch)
+    {
+    }
+
+    ~PipeLine()
+    {
+        close(readFd);
+    }
+
+    int fd() const override
+    {
+        return readFd;
+    }
+
+    uint32_t pollEvents() const override
+    {
+        return EPOLLIN;
+    }
+
+    int readEvents(GpioEvent* events, size_t max) override
+    {
+        std::array<char, maxGpioEvents> buf;
+        auto n = read(readFd, buf.data(), std::min({max, batch, buf.size()}));
+        if (n < 0)
+        {
+            return (errno == EAGAIN) ? 0 : -errno;
+        }
+
+        auto now = monotonicNow();
+        for (ssize_t i = 0; i < n; i++)
+        {
+            events[i] = {now, ++seqno, static_cast<uint8_t>(buf[i] != '0')};
+        }
+        return n;
+    }
+
+  private:
+    int readFd;
+    size_t batch;
+    uint32_t seqno = 0;
+};
+
+/**
+ * @class PeerBus
+ *
+ * A private D-Bus connection without a bus daemon: the buttons serve
+ * one end of a socket pair, and the other end counts the button
+ * signals that reach it.  Both ends run on the loop of the buttons.
+ */
+class PeerBus
+{
+  public:
+    PeerBus(const PeerBus&) = delete;
+    PeerBus& operator=(const PeerBus&) = delete;
+
+    explicit PeerBus(EventPtr& event) : PeerBus(event, socketPair())
+    {
+    }
+
+    ~PeerBus()
+    {
+        sd_bus_flush_close_unref(client);
+    }
+
+    sdbusplus::bus::bus bus;
+    uint64_t signals = 0;
+
+  private:
+    PeerBus(EventPtr& event, std::array<int, 2> fds) :
+        bus(open(event, fds[0], true), std::false_type{}),
+        client(open(event, fds[1], false))
+    {
+        int ret = sd_bus_add_filter(client, nullptr, countSignal, this);
+        if (ret < 0)
+        {
+            sd_bus_flush_close_unref(client);
+            throw std::runtime_error("Failed to watch the button signals");
+        }
+    }
+
+    static std::array<int, 2> socketPair()
+    {
+        std::array<int, 2> fds;
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0,
+                       fds.data()) < 0)
+        {
+            throw std::runtime_error("Failed to create a socket pair");
+        }
+        return fds;
+    }
+
+    /**
+     * @brief Starts one end of the connection on the loop
+     *
+     * @param[in] event - the loop
+     * @param[in] fd - the socket of this end, closed with the bus
+     * @param[in] server - whether this end is the one the buttons serve
+     *
+     * @return the bus
+     */
+    static sd_bus* open(EventPtr& event, int fd, bool server)
+    {
+        sd_bus* bus = nullptr;
+        int ret = sd_bus_new(&bus);
+        if (ret < 0)
+        {
+            close(fd);
+            throw std::runtime_error("Failed to create a bus");
+        }
+
+        sd_id128_t id;
+        ret = sd_bus_set_fd(bus, fd, fd);
+        if (ret >= 0 && server)
+        {
+            ret = sd_id128_randomize(&id);
+            if (ret >= 0)
+            {
+                ret = sd_bus_set_server(bus, 1, id);
+            }
+        }
+        if (ret >= 0)
+        {
+            ret = sd_bus_start(bus);
+        }
+        if (ret >= 0)
+        {
+            ret = sd_bus_attach_event(bus, event.get(),
+                                      SD_EVENT_PRIORITY_NORMAL);
+        }
+        if (ret < 0)
+        {
+            sd_bus_flush_close_unref(bus);
+            throw std::runtime_error("Failed to start a bus");
+        }
+        return bus;
+    }
+
+    static int countSignal(sd_bus_message* msg, void* userdata,
+                           sd_bus_error*)
+    {
+        if (sd_bus_message_is_signal(msg, powerInterface, nullptr) > 0)
+        {
+            static_cast<PeerBus*>(userdata)->signals++;
+        }
+        return 0;
+    }
+
+    static constexpr const char* powerInterface =
+        "xyz.openbmc_project.Chassis.Buttons.Power";
+
+    sd_bus* client;
+};
+
+/**
+ * @brief The loop and power buttons of one edge run, on a private
+ *        bus, with their pipes already holding every edge
+ */
+struct EdgeRun
+{
+    EventPtr event;
+    std::unique_ptr<PeerBus> peer;
+    std::vector<std::unique_ptr<PowerButton>> buttons;
+    // Kept open, so a line that has been read to the end isn't ready
+    std::vector<int> writeFds;
+    uint64_t edges = 0;
+    // The actions the buttons sent, to wait for their signals
+    uint64_t actions = 0;
+
+    EdgeRun(const GpioDefinitions& defs, unsigned count, uint64_t edgesPerLine,
+            size_t batch)
+    {
+        sd_event* loop = nullptr;
+        if (sd_event_new(&loop) < 0)
+        {
+            throw std::runtime_error("Failed to create an event loop");
+        }
+        event.reset(loop);
+        peer = std::make_unique<PeerBus>(event);
+
+        for (unsigned i = 0; i < count; i++)
+        {
+            int fds[2];
+            if (pipe2(fds, O_NONBLOCK | O_CLOEXEC) < 0)
+            {
+                throw std::runtime_error("Failed to create a pipe");
+            }
+
+            // Queue the edges up front, so only the reading side is
+            // measured: alternate presses and releases
+            fcntl(fds[1], F_SETPIPE_SZ, edgesPerLine);
+            std::string levels;
+            for (uint64_t e = 0; e < edgesPerLine; e++)
+            {
+                levels += (e % 2) ? '1' : '0';
+            }
+            auto written = write(fds[1], levels.data(), levels.size());
+            writeFds.push_back(fds[1]);
+            if (written != static_cast<ssize_t>(levels.size()))
+            {
+                throw std::runtime_error("Edges don't fit in the pipe");
+            }
+            edges += written;
+
+            auto path = POWER_DBUS_OBJECT_NAME + std::to_string(i);
+            buttons.push_back(std::make_unique<PowerButton>(
+                peer->bus, path.c_str(), event, defs,
+                std::make_unique<PipeLine>(fds[0], batch),
+                "BUTTON" + std::to_string(i)));
+            buttons.back()->forwardTo([this](ButtonAction) { actions++; });
+        }
+    }
+
+    ~EdgeRun()
+    {
+        buttons.clear();
+        for (auto fd : writeFds)
+        {
+            close(fd);
+        }
+    }
+
+    /**
+     * @brief Runs the loop until every edge was read and the signals
+     *        of their actions arrived
+     *
+     * @return the loop iterations
+     */
+    uint64_t run()
+    {
+        uint64_t iterations = 0;
+        auto done = [this]() {
+            uint64_t read = 0;
+            for (const auto& button : buttons)
+            {
+                read += button->buttonState().counters.edges;
+            }
+            return read == edges && peer->signals == actions;
+        };
+
+        while (!done())
+        {
+            sd_event_run(event.get(), UINT64_MAX);
+            iterations++;
+        }
+        return iterations;
+    }
+};
+
+void usage(const char* name)
+{
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "Measures the startup and the edge path of the buttons daemon\n"
+            "against a fake sysfs GPIO tree, with edges fed through pipes\n"
+            "to power buttons on a private D-Bus connection.\n"
+            "  --buttons <n>      Button GPIOs, default 4\n"
+            "  --edges <n>        Edges per button, default 20000\n"
+            "  --batch <n>        Edges read per wakeup, 1 like sysfs\n"
+            "                     (default) up to 16 like cdev\n"
+            "  --debounce-ms <ms> Debounce time of the buttons, default 0\n",
+            name);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    unsigned buttons = 4;
+    uint64_t edgesPerLine = 20000;
+    size_t batch = 1;
+    unsigned debounceMs = 0;
+
+    static const option options[] = {
+        {"buttons", required_argument, nullptr, 'b'},
+        {"edges", required_argument, nullptr, 'e'},
+        {"batch", required_argument, nullptr, 'n'},
+        {"debounce-ms", required_argument, nullptr, 'd'},
+        {nullptr, 0, nullptr, 0}};
+
+    int opt;
+    while ((opt = getopt_long(argc, argv, "b:e:n:d:", options, nullptr)) !=
+           -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                buttons = std::max(std::atoi(optarg), 1);
+                break;
+            case 'e':
+                edgesPerLine = std::max(std::atoll(optarg), 2LL);
+                break;
+            case 'n':
+                batch = std::clamp<size_t>(std::atoi(optarg), 1,
+                                           maxGpioEvents);
+                break;
+            case 'd':
+                debounceMs = std::max(std::atoi(optarg), 0);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    try
+    {
+        FakeSysfs sysfs{"bench-gpio", buttons};
+        std::vector<unsigned> offsets;
+        for (unsigned i = 0; i < buttons; i++)
+        {
+            sysfs.exportGpio(i);
+            offsets.push_back(i);
+        }
+        auto defsPath = sysfs.writeDefinitions(offsets, debounceMs);
+
+        // Startup: what the daemon does before its loop runs, less
+        // the D-Bus objects
+        auto start = Clock::now();
+        GpioDefinitions defs{defsPath};
+        auto parsed = msSince(start);
+        GpioChips chips{defs.backend(), sysfs.root()};
+        chips.scan();
+        auto scanned = msSince(start);
+        for (unsigned i = 0; i < buttons; i++)
+        {
+            if (!configGpio(defs, chips, "BUTTON" + std::to_string(i)))
+            {
+                throw std::runtime_error("Failed to configure a GPIO");
+            }
+        }
+        auto configured = msSince(start);
+        printf("Startup: %.3f ms, parse %.3f ms, scan %.3f ms, "
+               "%u GPIOs %.3f ms\n",
+               configured, parsed, scanned - parsed, buttons,
+               configured - scanned);
+
+        // Edges: read through the loop and the buttons, and sent out
+        // as signals
+        uint64_t iterations = 0;
+        uint64_t edges = 0;
+        uint64_t signals = 0;
+        double elapsed = 0;
+        {
+            EdgeRun run{defs, buttons, edgesPerLine, batch};
+            edges = run.edges;
+            start = Clock::now();
+            iterations = run.run();
+            elapsed = msSince(start) / 1000;
+            signals = run.peer->signals;
+        }
+        printf("Edges: %llu in %.3f s, %.0f edges/s, %.2f loop iterations "
+               "per edge, %llu signals\n",
+               static_cast<unsigned long long>(edges), elapsed,
+               elapsed > 0 ? edges / elapsed : 0.0,
+               static_cast<double>(iterations) / edges,
+               static_cast<unsigned long long>(signals));
+
+        std::unique_ptr<EdgeRun> traced;
+        SyscallCounts syscalls;
+        int status = countSyscalls(
+            [&]() {
+                traced = std::make_unique<EdgeRun>(defs, buttons, edgesPerLine,
+                                                   batch);
+            },
+            [&]() { traced->run(); }, syscalls);
+        if (status == 0)
+        {
+            printf("Syscalls: %.2f per edge\n",
+                   static_cast<double>(syscalls.total) / edges);
+        }
+        else
+        {
+            printf("Syscalls: not counted, the child can't be traced\n");
+        }
+    }
+    catch (std::exception& e)
+    {
+        fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,319 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "button_machine.hpp"
+#include "button_state.hpp"
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+/*
+ * A press is classified from the timestamps of its edges, so how late
+ * the loop gets to them must not change the result.  ButtonBase reads
+ * the edges before it runs the timers that came due meanwhile, which
+ * is the order these tests process them in.
+ */
+
+/**
+ * @brief A ButtonMachine that keeps the actions it sends
+ */
+class RecordingMachine : public ButtonMachine
+{
+  public:
+    using ButtonMachine::ButtonMachine;
+
+    std::vector<ButtonAction> actions;
+    // The gestures, with the actions sent before each
+    std::vector<std::pair<uint8_t, size_t>> gestures;
+
+  protected:
+    void send(ButtonAction action, bool heldBack) override
+    {
+        actions.push_back(action);
+    }
+
+    void held(uint8_t tier) override
+    {
+    }
+
+    void clicked(uint8_t count) override
+    {
+        gestures.emplace_back(count, actions.size());
+    }
+};
+
+static constexpr uint64_t msNs = 1000000;
+static constexpr uint64_t pressTime = 1000 * msNs;
+static constexpr uint64_t holdTime = 3000 * msNs;
+
+class LoopDelayTest : public ::testing::TestWithParam<uint64_t>
+{
+  protected:
+    void SetUp() override
+    {
+        policy.holdTimes[0] = holdTime;
+        policy.holdTiers = 1;
+    }
+
+    // Runs the edges on a loop that wakes up the delay late, for an
+    // edge or for the hold timer, and then reads every edge that
+    // happened by then before it runs the timer
+    std::vector<ButtonAction> runLate(const std::vector<GpioEvent>& edges)
+    {
+        std::vector<ButtonAction> actions;
+        for (size_t next = 0; next < edges.size();)
+        {
+            auto wakeup = edges[next].timestamp;
+            auto deadline = holdDeadline(state, policy);
+            if (deadline)
+            {
+                wakeup = std::min(wakeup, *deadline);
+            }
+            wakeup += GetParam();
+
+            for (; next < edges.size() && edges[next].timestamp <= wakeup;
+                 next++)
+            {
+                auto action = processEdge(state, policy, edges[next]);
+                if (action != ButtonAction::none)
+                {
+                    actions.push_back(action);
+                }
+            }
+            if (holdExpired(state, policy, wakeup))
+            {
+                actions.push_back(ButtonAction::pressedLong);
+            }
+        }
+        return actions;
+    }
+
+    ButtonPolicy policy;
+    ButtonState state;
+};
+
+TEST_P(LoopDelayTest, ShortPressStaysShort)
+{
+    auto release = pressTime + holdTime - 100 * msNs;
+    std::vector<ButtonAction> expected = {ButtonAction::pressed,
+                                          ButtonAction::released};
+    EXPECT_EQ(runLate({{pressTime, 0, 0}, {release, 0, 1}}), expected);
+    EXPECT_EQ(state.counters.longPresses, 0);
+}
+
+TEST_P(LoopDelayTest, LongPressStaysLong)
+{
+    // The hold timer may run before the release is read or not, either
+    // way there is one long press and no release
+    auto release = pressTime + holdTime + 100 * msNs;
+    std::vector<ButtonAction> expected = {ButtonAction::pressed,
+                                          ButtonAction::pressedLong};
+    EXPECT_EQ(runLate({{pressTime, 0, 0}, {release, 0, 1}}), expected);
+    EXPECT_EQ(state.counters.longPresses, 1);
+}
+
+TEST_P(LoopDelayTest, ReleaseAtTheHoldTimeIsLong)
+{
+    // Whether the release or the hold timer is seen first
+    auto release = pressTime + holdTime;
+    std::vector<ButtonAction> expected = {ButtonAction::pressed,
+                                          ButtonAction::pressedLong};
+    EXPECT_EQ(runLate({{pressTime, 0, 0}, {release, 0, 1}}), expected);
+    EXPECT_EQ(state.counters.longPresses, 1);
+}
+
+TEST_P(LoopDelayTest, DebouncedReleaseKeepsItsEdgeTime)
+{
+    policy.debounceTime = 20 * msNs;
+
+    // A press, then a release that bounces just before the hold time
+    auto& debounce = state.debounce;
+    EXPECT_FALSE(debounceEdge(debounce, policy, {pressTime, 0, 0}));
+    auto press = debounceSettle(debounce, pressTime + 20 * msNs + GetParam());
+    ASSERT_TRUE(press);
+    EXPECT_EQ(processEdge(state, policy, *press), ButtonAction::pressed);
+
+    auto release = pressTime + holdTime - 10 * msNs;
+    for (uint64_t bounce = 0; bounce < 4; bounce++)
+    {
+        EXPECT_FALSE(debounceEdge(debounce, policy,
+                                  {release + bounce * msNs, 0,
+                                   static_cast<uint8_t>(!(bounce % 2))}));
+    }
+    EXPECT_FALSE(debounceEdge(debounce, policy, {release + 4 * msNs, 0, 1}));
+
+    auto settled = debounceSettle(debounce, debounce.deadline + GetParam());
+    ASSERT_TRUE(settled);
+    EXPECT_EQ(settled->timestamp, release);
+    EXPECT_EQ(processEdge(state, policy, *settled), ButtonAction::released);
+    EXPECT_EQ(state.counters.longPresses, 0);
+}
+
+TEST_P(LoopDelayTest, HoldWaitsForADebouncedRelease)
+{
+    policy.debounceTime = 20 * msNs;
+    RecordingMachine machine{policy};
+
+    // The release starts before the hold time and is still bouncing
+    // when it passes, so its timer runs inside the debounce window
+    auto release = pressTime + holdTime - 10 * msNs;
+    std::vector<GpioEvent> edges = {{pressTime, 0, 0},
+                                    {release, 0, 1},
+                                    {release + 5 * msNs, 0, 0},
+                                    {release + 10 * msNs, 0, 1}};
+
+    // Like ButtonBase: the loop wakes up the delay late, reads the
+    // edges seen by then and runs the timers due
+    for (size_t next = 0; next < edges.size();)
+    {
+        auto wakeup = edges[next].timestamp;
+        auto deadline = machine.nextDeadline();
+        if (deadline)
+        {
+            wakeup = std::min(wakeup, *deadline);
+        }
+        wakeup += GetParam();
+
+        for (; next < edges.size() && edges[next].timestamp <= wakeup;
+             next++)
+        {
+            machine.edge(edges[next]);
+        }
+        machine.expire(wakeup);
+    }
+    machine.expire(release + holdTime);
+
+    std::vector<ButtonAction> expected = {ButtonAction::pressed,
+                                          ButtonAction::released};
+    EXPECT_EQ(machine.actions, expected);
+    EXPECT_EQ(machine.buttonState().counters.longPresses, 0);
+}
+
+INSTANTIATE_TEST_SUITE_P(Delays, LoopDelayTest,
+                         ::testing::Values(0, 50 * msNs, 500 * msNs,
+                                           2000 * msNs, 10000 * msNs));
+
+TEST(ButtonStateTest, HoldOnlyTiersStillReportRelease)
+{
+    ButtonPolicy policy;
+    policy.holdTimes[0] = holdTime;
+    policy.holdTiers = 1;
+    policy.longPress = false;
+    ButtonState state;
+
+    EXPECT_EQ(processEdge(state, policy, {pressTime, 0, 0}),
+              ButtonAction::pressed);
+    EXPECT_TRUE(holdExpired(state, policy, pressTime + holdTime));
+    EXPECT_EQ(state.holdTier, 1);
+    EXPECT_EQ(processEdge(state, policy, {pressTime + 2 * holdTime, 0, 1}),
+              ButtonAction::released);
+    EXPECT_EQ(state.counters.longPresses, 0);
+}
+
+/*
+ * The handler acts on Released, so with a click window every gesture
+ * gives it one release at most, once the gesture is over.
+ */
+class ClickTest : public ::testing::Test
+{
+  protected:
+    ClickTest() : machine(makePolicy())
+    {
+    }
+
+    static ButtonPolicy makePolicy()
+    {
+        ButtonPolicy policy;
+        policy.holdTimes[0] = holdTime;
+        policy.holdTiers = 1;
+        policy.clickWindow = clickWindow;
+        return policy;
+    }
+
+    void click(uint64_t time)
+    {
+        machine.edge({time, 0, 0});
+        machine.edge({time + 100 * msNs, 0, 1});
+    }
+
+    static constexpr uint64_t clickWindow = 400 * msNs;
+    RecordingMachine machine;
+};
+
+TEST_F(ClickTest, SingleClickReleasesWhenOver)
+{
+    click(pressTime);
+    std::vector<ButtonAction> pressed = {ButtonAction::pressed};
+    EXPECT_EQ(machine.actions, pressed);
+
+    machine.expire(pressTime + 100 * msNs + clickWindow);
+    std::vector<ButtonAction> expected = {ButtonAction::pressed,
+                                          ButtonAction::released};
+    EXPECT_EQ(machine.actions, expected);
+    std::vector<std::pair<uint8_t, size_t>> gestures = {{1, 2}};
+    EXPECT_EQ(machine.gestures, gestures);
+}
+
+TEST_F(ClickTest, MultiClickSendsNoRelease)
+{
+    click(pressTime);
+    click(pressTime + 200 * msNs);
+    click(pressTime + 400 * msNs);
+    machine.expire(pressTime + 500 * msNs + clickWindow);
+
+    std::vector<ButtonAction> expected(3, ButtonAction::pressed);
+    EXPECT_EQ(machine.actions, expected);
+    std::vector<std::pair<uint8_t, size_t>> gestures = {{3, 3}};
+    EXPECT_EQ(machine.gestures, gestures);
+}
+
+TEST_F(ClickTest, PressAfterTheWindowEndsTheGesture)
+{
+    // The click timer hasn't run when the next press is read
+    click(pressTime);
+    click(pressTime + 100 * msNs + clickWindow + 50 * msNs);
+
+    std::vector<ButtonAction> expected = {
+        ButtonAction::pressed, ButtonAction::released, ButtonAction::pressed};
+    EXPECT_EQ(machine.actions, expected);
+    std::vector<std::pair<uint8_t, size_t>> gestures = {{1, 2}};
+    EXPECT_EQ(machine.gestures, gestures);
+}
+
+TEST_F(ClickTest, LongPressEndsTheGesture)
+{
+    auto press = pressTime + 200 * msNs;
+    click(pressTime);
+    machine.edge({press, 0, 0});
+    machine.expire(press + holdTime);
+
+    // The click goes out once the press is long, before the long
+    // press itself
+    std::vector<ButtonAction> expected = {
+        ButtonAction::pressed, ButtonAction::pressed, ButtonAction::released,
+        ButtonAction::pressedLong};
+    EXPECT_EQ(machine.actions, expected);
+    std::vector<std::pair<uint8_t, size_t>> gestures = {{1, 3}};
+    EXPECT_EQ(machine.gestures, gestures);
+
+    machine.edge({press + holdTime + 100 * msNs, 0, 1});
+    machine.expire(press + holdTime + 100 * msNs + clickWindow);
+    EXPECT_EQ(machine.actions, expected);
+    EXPECT_EQ(machine.gestures, gestures);
+}
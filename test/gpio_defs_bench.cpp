@@ -0,0 +1,110 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gpio.hpp"
+
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/*
+ * Measures how the startup parse of the GPIO definitions file scales
+ * with the number of definitions in it, and the cost of the lookups
+ * the buttons make against the parsed definitions.
+ */
+
+template <typename Operation>
+static double nsPerOp(size_t ops, Operation operation)
+{
+    auto start = std::chrono::steady_clock::now();
+    operation();
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+static void writeDefinitions(const std::string& path, size_t count)
+{
+    std::ofstream defs{path};
+    defs << "{\"gpio_definitions\": [";
+    for (size_t i = 0; i < count; i++)
+    {
+        defs << (i ? "," : "") << "\n    {\"name\": \"GPIO_" << i
+             << "\", \"pin\": \"" << static_cast<char>('A' + i % 26)
+             << i % 8 << "\", \"direction\": \"both\"}";
+    }
+    defs << "\n]}\n";
+}
+
+int main()
+{
+    char path[] = "/tmp/gpio_defs_bench.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0)
+    {
+        fprintf(stderr, "Failed to create the definitions file\n");
+        return 1;
+    }
+    close(fd);
+
+    printf("%12s %12s %14s %12s\n", "definitions", "parse us",
+           "parse ns/def", "lookup ns");
+    for (size_t count : {10, 100, 1000, 10000})
+    {
+        writeDefinitions(path, count);
+
+        size_t rounds = 100000 / count;
+        auto parse = nsPerOp(rounds, [&]() {
+            for (size_t i = 0; i < rounds; i++)
+            {
+                GpioDefinitions defs{path};
+            }
+        });
+
+        GpioDefinitions defs{path};
+        std::vector<std::string> names;
+        for (size_t i = 0; i < count; i++)
+        {
+            names.push_back("GPIO_" + std::to_string(i));
+        }
+
+        constexpr size_t lookups = 1000000;
+        size_t found = 0;
+        auto lookup = nsPerOp(lookups, [&]() {
+            for (size_t i = 0; i < lookups; i++)
+            {
+                found += defs.contains(names[i % count]);
+            }
+        });
+        if (found != lookups)
+        {
+            fprintf(stderr, "Lost definitions with %zu of them\n", count);
+            unlink(path);
+            return 1;
+        }
+
+        printf("%12zu %12.1f %14.1f %12.1f\n", count, parse / 1000,
+               parse / count, lookup);
+    }
+
+    unlink(path);
+    return 0;
+}
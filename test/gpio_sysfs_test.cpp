@@ -0,0 +1,136 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "gpio.hpp"
+#include "sysfs_harness.hpp"
+
+#include <unistd.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <gtest/gtest.h>
+
+/*
+ * Sled hot plug configures the GPIOs again at runtime, so the number
+ * of system calls a sysfs line takes to bring up is kept in check.
+ * Logging goes to the journal with sendmsg, so it isn't counted.
+ */
+
+class SysfsConfigTest : public ::testing::Test
+{
+  protected:
+    SysfsConfigTest() : sysfs("test-gpio", 8)
+    {
+        defs = std::make_unique<GpioDefinitions>(
+            sysfs.writeDefinitions({offset}));
+        chips = std::make_unique<GpioChips>(GpioBackend::sysfs, sysfs.root());
+        chips->scan();
+    }
+
+    // Brings the line up and releases it again
+    int configure(SyscallCounts& counts)
+    {
+        return countSyscalls(
+            nullptr,
+            [this]() {
+                if (!configGpio(*defs, *chips, "BUTTON3"))
+                {
+                    _exit(1);
+                }
+            },
+            counts, [this]() { sysfs.exportWritten(); });
+    }
+
+    std::string attribute(const char* name)
+    {
+        std::ifstream file{sysfs.gpio(offset) + "/" + name};
+        std::string value;
+        file >> value;
+        return value;
+    }
+
+    static constexpr unsigned offset = 3;
+    FakeSysfs sysfs;
+    std::unique_ptr<GpioDefinitions> defs;
+    std::unique_ptr<GpioChips> chips;
+};
+
+TEST_F(SysfsConfigTest, ExportedLineConfiguration)
+{
+    sysfs.exportGpio(offset, "out", "none");
+    SyscallCounts counts;
+    int status = configure(counts);
+    if (status < 0)
+    {
+        GTEST_SKIP() << "The configuration can't be traced";
+    }
+    ASSERT_EQ(status, 0);
+
+    // The gpioN directory, the value file and the two attributes
+    EXPECT_EQ(counts.opens, 4);
+    // Each attribute, and the value to prime the edge notification
+    EXPECT_EQ(counts.reads, 3);
+    // direction and edge
+    EXPECT_EQ(counts.writes, 2);
+    EXPECT_EQ(counts.seeks, 0);
+    EXPECT_EQ(counts.closes, 4);
+
+    EXPECT_EQ(attribute("edge"), "both");
+}
+
+TEST_F(SysfsConfigTest, UnexportedLineConfiguration)
+{
+    SyscallCounts counts;
+    int status = configure(counts);
+    if (status < 0)
+    {
+        GTEST_SKIP() << "The configuration can't be traced";
+    }
+    ASSERT_EQ(status, 0);
+
+    // The missing gpioN directory, export, then as for an exported
+    // line
+    EXPECT_EQ(counts.opens, 6);
+    EXPECT_EQ(counts.reads, 3);
+    // The number to export, and the edge of a line exported as an
+    // input with no edge
+    EXPECT_EQ(counts.writes, 2);
+    EXPECT_EQ(counts.seeks, 0);
+    EXPECT_EQ(counts.closes, 5);
+
+    EXPECT_EQ(attribute("direction"), "in");
+    EXPECT_EQ(attribute("edge"), "both");
+}
+
+TEST_F(SysfsConfigTest, ReconfigurationWritesNothing)
+{
+    sysfs.exportGpio(offset, "in", "both");
+    SyscallCounts counts;
+    int status = configure(counts);
+    if (status < 0)
+    {
+        GTEST_SKIP() << "The configuration can't be traced";
+    }
+    ASSERT_EQ(status, 0);
+
+    EXPECT_EQ(counts.opens, 4);
+    EXPECT_EQ(counts.reads, 3);
+    EXPECT_EQ(counts.writes, 0);
+    EXPECT_EQ(counts.seeks, 0);
+    EXPECT_EQ(counts.closes, 4);
+}
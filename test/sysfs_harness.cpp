@@ -0,0 +1,220 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "sysfs_harness.hpp"
+
+#include <signal.h>
+#include <sys/ptrace.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <exception>
+#include <experimental/filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::experimental::filesystem;
+
+int countSyscalls(const std::function<void()>& setup,
+                  const std::function<void()>& run, SyscallCounts& counts,
+                  const std::function<void()>& afterWrite)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        return -1;
+    }
+
+    if (pid == 0)
+    {
+        try
+        {
+            if (setup)
+            {
+                setup();
+            }
+        }
+        catch (std::exception& e)
+        {
+            _exit(2);
+        }
+        if (ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) < 0)
+        {
+            _exit(2);
+        }
+        raise(SIGSTOP);
+        run();
+        _exit(0);
+    }
+
+    int status = 0;
+    if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status))
+    {
+        return -1;
+    }
+    ptrace(PTRACE_SETOPTIONS, pid, nullptr,
+           reinterpret_cast<void*>(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+
+    bool traced = true;
+    int signal = 0;
+    // The exit stop of a call doesn't say which call it was
+    uint64_t entered = 0;
+    for (;;)
+    {
+        ptrace(PTRACE_SYSCALL, pid, nullptr,
+               reinterpret_cast<void*>(static_cast<intptr_t>(signal)));
+        if (waitpid(pid, &status, 0) < 0 || !WIFSTOPPED(status))
+        {
+            break;
+        }
+
+        signal = 0;
+        if (WSTOPSIG(status) != (SIGTRAP | 0x80))
+        {
+            signal = WSTOPSIG(status);
+            continue;
+        }
+
+        __ptrace_syscall_info info{};
+        if (ptrace(PTRACE_GET_SYSCALL_INFO, pid,
+                   reinterpret_cast<void*>(sizeof(info)), &info) <= 0)
+        {
+            traced = false;
+            continue;
+        }
+        if (info.op == PTRACE_SYSCALL_INFO_EXIT)
+        {
+            if (afterWrite &&
+                (entered == SYS_write || entered == SYS_pwrite64))
+            {
+                afterWrite();
+            }
+            continue;
+        }
+        if (info.op != PTRACE_SYSCALL_INFO_ENTRY)
+        {
+            continue;
+        }
+
+        entered = info.entry.nr;
+        counts.total++;
+        switch (entered)
+        {
+#ifdef SYS_open
+            case SYS_open:
+#endif
+            case SYS_openat:
+                counts.opens++;
+                break;
+            case SYS_read:
+            case SYS_pread64:
+                counts.reads++;
+                break;
+            case SYS_write:
+            case SYS_pwrite64:
+                counts.writes++;
+                break;
+            case SYS_lseek:
+                counts.seeks++;
+                break;
+            case SYS_close:
+                counts.closes++;
+                break;
+        }
+    }
+
+    if (!traced || !WIFEXITED(status))
+    {
+        return -1;
+    }
+    return WEXITSTATUS(status);
+}
+
+FakeSysfs::FakeSysfs(const std::string& label, unsigned ngpio) : label(label)
+{
+    char dirTemplate[] = "/tmp/fake_sysfs.XXXXXX";
+    if (!mkdtemp(dirTemplate))
+    {
+        throw std::runtime_error("Failed to create a directory");
+    }
+    dir = dirTemplate;
+
+    auto chip = root() + "/gpiochip0";
+    fs::create_directories(chip);
+    std::ofstream{chip + "/label"} << label << "\n";
+    std::ofstream{chip + "/base"} << "0\n";
+    std::ofstream{chip + "/ngpio"} << ngpio << "\n";
+    std::ofstream{root() + "/export"};
+}
+
+FakeSysfs::~FakeSysfs()
+{
+    fs::remove_all(dir);
+}
+
+std::string FakeSysfs::root() const
+{
+    // Not the directory itself, which also holds the definitions
+    return dir + "/gpio";
+}
+
+std::string FakeSysfs::gpio(unsigned offset) const
+{
+    return root() + "/gpio" + std::to_string(offset);
+}
+
+void FakeSysfs::exportGpio(unsigned offset, const std::string& direction,
+                           const std::string& edge)
+{
+    auto path = gpio(offset);
+    fs::create_directories(path);
+    std::ofstream{path + "/value"} << "1\n";
+    std::ofstream{path + "/direction"} << direction << "\n";
+    std::ofstream{path + "/edge"} << edge << "\n";
+}
+
+void FakeSysfs::exportWritten()
+{
+    auto exportPath = root() + "/export";
+    unsigned offset = 0;
+    bool written = static_cast<bool>(std::ifstream{exportPath} >> offset);
+    // Emptied, so the next number isn't written over this one
+    std::ofstream{exportPath, std::ios::trunc};
+    if (written && !fs::exists(gpio(offset)))
+    {
+        exportGpio(offset);
+    }
+}
+
+std::string FakeSysfs::writeDefinitions(const std::vector<unsigned>& offsets,
+                                        unsigned debounceMs)
+{
+    auto path = dir + "/gpio_defs.json";
+    std::ofstream defs{path};
+    defs << "{\"gpio_backend\": \"sysfs\", \"gpio_definitions\": [";
+    for (size_t i = 0; i < offsets.size(); i++)
+    {
+        defs << (i ? "," : "") << "{\"name\": \"BUTTON" << offsets[i]
+             << "\", \"chip\": \"" << label
+             << "\", \"offset\": " << offsets[i]
+             << ", \"direction\": \"both\", \"debounce_ms\": " << debounceMs
+             << "}";
+    }
+    defs << "]}\n";
+    return path;
+}
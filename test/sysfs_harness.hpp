@@ -0,0 +1,132 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#pragma once
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+/*
+ * Helpers shared by the tests and benchmarks that run against a
+ * sysfs GPIO tree and count the system calls made on it.
+ */
+
+/**
+ * @brief The system calls a traced function made, in total and the
+ *        file system ones by kind
+ */
+struct SyscallCounts
+{
+    uint64_t total = 0;
+    unsigned opens = 0;
+    unsigned reads = 0;
+    unsigned writes = 0;
+    unsigned seeks = 0;
+    unsigned closes = 0;
+};
+
+/**
+ * @brief Runs a function in a child process under ptrace and counts
+ *        its system calls
+ *
+ * The child is stopped once the setup is done, so only the calls of
+ * run and the child exiting are counted.  An event loop can't be used
+ * across a fork, so anything that needs one is made by the setup.
+ *
+ * @param[in] setup - run in the child before counting starts, exits
+ *                    the child with 2 if it throws
+ * @param[in] run - run in the child, counted
+ * @param[out] counts - the calls counted
+ * @param[in] afterWrite - if set, called whenever a write of the
+ *                         child returns, while the child is stopped
+ *
+ * @return the exit status of the child, or -1 if it can't be traced
+ */
+int countSyscalls(const std::function<void()>& setup,
+                  const std::function<void()>& run, SyscallCounts& counts,
+                  const std::function<void()>& afterWrite = nullptr);
+
+/**
+ * @class FakeSysfs
+ *
+ * A sysfs GPIO tree with one controller in a temporary directory,
+ * removed with the object, and the GPIO definitions for it.
+ */
+class FakeSysfs
+{
+  public:
+    FakeSysfs(const FakeSysfs&) = delete;
+    FakeSysfs& operator=(const FakeSysfs&) = delete;
+
+    /**
+     * @brief Constructor
+     *
+     * @param[in] label - the label of the controller
+     * @param[in] ngpio - the GPIOs of the controller, based at 0
+     *
+     * @throw std::runtime_error if the directory can't be made
+     */
+    FakeSysfs(const std::string& label, unsigned ngpio);
+
+    ~FakeSysfs();
+
+    /**
+     * @brief The directory to scan for controllers, like
+     *        /sys/class/gpio
+     */
+    std::string root() const;
+
+    /**
+     * @brief The gpioN directory of a GPIO, whether it exists or not
+     */
+    std::string gpio(unsigned offset) const;
+
+    /**
+     * @brief Adds the gpioN directory of a GPIO, as exporting it would
+     *
+     * @param[in] offset - the GPIO
+     * @param[in] direction - its direction attribute
+     * @param[in] edge - its edge attribute
+     */
+    void exportGpio(unsigned offset, const std::string& direction = "in",
+                    const std::string& edge = "none");
+
+    /**
+     * @brief Does what the kernel does on a write to the export file:
+     *        adds the GPIO written to it, if it isn't there yet
+     *
+     * For the afterWrite of countSyscalls(), so the directory is
+     * there when the write returns.
+     */
+    void exportWritten();
+
+    /**
+     * @brief Writes the sysfs GPIO definitions of buttons named
+     *        BUTTON<offset>
+     *
+     * @param[in] offsets - the GPIOs of the buttons
+     * @param[in] debounceMs - the debounce time of every button
+     *
+     * @return the path of the definitions file
+     */
+    std::string writeDefinitions(const std::vector<unsigned>& offsets,
+                                 unsigned debounceMs = 0);
+
+  private:
+    std::string label;
+    std::string dir;
+};
@@ -0,0 +1,133 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "timer.hpp"
+
+#include <time.h>
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+/*
+ * Measures the cost of the Timer operations the buttons make on every
+ * edge: arming, pushing a deadline back and cancelling, with a number
+ * of other timers pending on the wheel, and of firing timers.
+ */
+
+static uint64_t monotonicNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+template <typename Operation>
+static double nsPerOp(size_t ops, Operation operation)
+{
+    auto start = std::chrono::steady_clock::now();
+    operation();
+    std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+    return elapsed.count() / ops;
+}
+
+int main()
+{
+    sd_event* loop = nullptr;
+    if (sd_event_new(&loop) < 0)
+    {
+        fprintf(stderr, "Failed to create an event loop\n");
+        return 1;
+    }
+    EventPtr event{loop};
+
+    constexpr size_t timers = 256;
+    constexpr size_t rounds = 20000;
+    constexpr uint64_t msNs = 1000000;
+
+    std::vector<std::unique_ptr<Timer>> active;
+    for (size_t i = 0; i < timers; i++)
+    {
+        active.push_back(std::make_unique<Timer>(event, [](uint64_t) {}));
+    }
+
+    printf("%10s %14s %14s %14s\n", "pending", "arm+cancel ns", "rearm ns",
+           "fire ns");
+    for (size_t pending : {0, 16, 1024, 65536})
+    {
+        auto base = monotonicNow();
+
+        // Keep timers pending over the whole range of the wheel
+        std::vector<std::unique_ptr<Timer>> idle;
+        for (size_t i = 0; i < pending; i++)
+        {
+            idle.push_back(std::make_unique<Timer>(event, [](uint64_t) {}));
+            idle.back()->arm(base + (i * 7919 % (1 << 22) + 1000) * msNs);
+        }
+
+        auto armCancel = nsPerOp(rounds * timers * 2, [&]() {
+            for (size_t r = 0; r < rounds; r++)
+            {
+                for (size_t i = 0; i < timers; i++)
+                {
+                    active[i]->arm(base + (i * 37 % 5000 + 1000) * msNs);
+                    active[i]->cancel();
+                }
+            }
+        });
+
+        // A debounce or hold timer moving with each edge
+        auto rearm = nsPerOp(rounds * timers, [&]() {
+            for (size_t r = 0; r < rounds; r++)
+            {
+                for (size_t i = 0; i < timers; i++)
+                {
+                    active[i]->arm(base + (r % 100 + i + 1000) * msNs);
+                }
+            }
+        });
+
+        // Deadlines already passed, all fire in the next iteration
+        size_t fired = 0;
+        std::vector<std::unique_ptr<Timer>> due;
+        for (size_t i = 0; i < timers * 16; i++)
+        {
+            due.push_back(
+                std::make_unique<Timer>(event, [&](uint64_t) { fired++; }));
+        }
+        auto fire = nsPerOp(due.size(), [&]() {
+            auto now = monotonicNow();
+            for (auto& timer : due)
+            {
+                timer->arm(now - msNs);
+            }
+            while (fired < due.size())
+            {
+                sd_event_run(loop, UINT64_MAX);
+            }
+        });
+
+        for (auto& timer : active)
+        {
+            timer->cancel();
+        }
+        printf("%10zu %14.1f %14.1f %14.1f\n", pending, armCancel, rearm,
+               fire);
+    }
+
+    return 0;
+}
@@ -0,0 +1,289 @@
+/*
+// Copyright (c) 2018 Intel Corporation
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+*/
+
+#include "timer_wheel.hpp"
+
+#include <unistd.h>
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+// A loop with a clock of its own, the wheel only uses its one time
+// source
+struct sd_event
+{
+    uint64_t usec = 0;
+    sd_event_source* time = nullptr;
+};
+
+struct sd_event_source
+{
+    sd_event* loop;
+    uint64_t usec;
+    int enabled;
+    sd_event_time_handler_t handler;
+    void* userdata;
+};
+
+extern "C" {
+
+int sd_event_add_time(sd_event* loop, sd_event_source** source, int,
+                      uint64_t usec, uint64_t, sd_event_time_handler_t handler,
+                      void* userdata)
+{
+    *source = new sd_event_source{loop, usec, SD_EVENT_ON, handler, userdata};
+    loop->time = *source;
+    return 0;
+}
+
+int sd_event_source_set_time(sd_event_source* source, uint64_t usec)
+{
+    source->usec = usec;
+    return 0;
+}
+
+int sd_event_source_set_enabled(sd_event_source* source, int enabled)
+{
+    source->enabled = enabled;
+    return 0;
+}
+
+sd_event_source* sd_event_source_unref(sd_event_source* source)
+{
+    if (source->loop->time == source)
+    {
+        source->loop->time = nullptr;
+    }
+    delete source;
+    return nullptr;
+}
+
+sd_event* sd_event_source_get_event(sd_event_source* source)
+{
+    return source->loop;
+}
+
+int sd_event_now(sd_event* loop, int, uint64_t* usec)
+{
+    *usec = loop->usec;
+    return 0;
+}
+}
+
+static constexpr uint64_t msNs = 1000000;
+static constexpr uint64_t blockMs = 1ULL << 24;
+
+class TimerWheelTest : public ::testing::Test
+{
+  protected:
+    void SetUp() override
+    {
+        // A wheel that stops advancing never returns from run()
+        alarm(30);
+    }
+
+    void TearDown() override
+    {
+        alarm(0);
+    }
+
+    void start(uint64_t ms)
+    {
+        wheel.reset();
+        loop.usec = ms * 1000;
+        wheel = std::make_unique<TimerWheel>(&loop);
+    }
+
+    void arm(TimerWheel::Entry& entry, uint64_t ms)
+    {
+        wheel->arm(entry, ms * msNs);
+    }
+
+    // Runs the loop until the clock reads ms
+    void advance(uint64_t ms)
+    {
+        auto target = ms * 1000;
+        auto source = loop.time;
+        while (source->enabled != SD_EVENT_OFF && source->usec <= target)
+        {
+            loop.usec = std::max(loop.usec, source->usec);
+            source->enabled = SD_EVENT_OFF;
+            source->handler(source, source->usec, source->userdata);
+            wakeups++;
+        }
+        loop.usec = std::max(loop.usec, target);
+    }
+
+    uint64_t nowMs() const
+    {
+        return loop.usec / 1000;
+    }
+
+    sd_event loop;
+    std::unique_ptr<TimerWheel> wheel;
+    unsigned wakeups = 0;
+};
+
+TEST_F(TimerWheelTest, FiresAcrossBlockBoundaries)
+{
+    for (uint64_t before : {1, 2, 10, 63, 64, 1000, 262144})
+    {
+        for (uint64_t after : {0, 1, 10, 64, 4096})
+        {
+            auto boundary = 3 * blockMs;
+            start(boundary - before);
+
+            uint64_t fired = 0;
+            TimerWheel::Entry entry;
+            entry.callback = [&](uint64_t) { fired = nowMs(); };
+            arm(entry, boundary + after);
+
+            advance(boundary + after - 1);
+            EXPECT_EQ(fired, 0) << before << " " << after;
+            advance(boundary + after + 100);
+            EXPECT_EQ(fired, boundary + after) << before << " " << after;
+        }
+    }
+}
+
+TEST_F(TimerWheelTest, FarDeadlines)
+{
+    start(blockMs - 5);
+
+    std::vector<uint64_t> deadlines = {blockMs * 2 + 7, blockMs * 3,
+                                       blockMs * 5 - 1, blockMs * 2 - 3};
+    std::vector<uint64_t> fired(deadlines.size());
+    std::vector<TimerWheel::Entry> entries(deadlines.size());
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        entries[i].callback = [&, i](uint64_t) { fired[i] = nowMs(); };
+        arm(entries[i], deadlines[i]);
+    }
+
+    advance(blockMs * 6);
+    EXPECT_EQ(fired, deadlines);
+
+    // At most a wakeup per level for each deadline, and the block starts
+    EXPECT_LE(wakeups, deadlines.size() * 4 + 4);
+}
+
+TEST_F(TimerWheelTest, PastDeadlinesFireOnTheNextRun)
+{
+    start(blockMs * 2 + 100);
+
+    unsigned fired = 0;
+    TimerWheel::Entry entry;
+    entry.callback = [&](uint64_t) { fired++; };
+    arm(entry, 50);
+
+    advance(blockMs * 2 + 100);
+    EXPECT_EQ(fired, 1);
+}
+
+TEST_F(TimerWheelTest, CancelledTimersDontFire)
+{
+    start(blockMs - 10);
+
+    unsigned fired = 0;
+    TimerWheel::Entry near, far;
+    near.callback = far.callback = [&](uint64_t) { fired++; };
+    arm(near, blockMs + 10);
+    arm(far, blockMs * 3);
+    wheel->cancel(near);
+    wheel->cancel(far);
+
+    advance(blockMs * 4);
+    EXPECT_EQ(fired, 0);
+    EXPECT_EQ(loop.time->enabled, SD_EVENT_OFF);
+}
+
+TEST_F(TimerWheelTest, MatchesSortedDeadlines)
+{
+    std::mt19937_64 rng(1);
+    constexpr size_t count = 500;
+
+    // Start just short of a block boundary, with deadlines from the
+    // past to a few blocks out, some of them armed again as they fire
+    start(blockMs * 7 - 20);
+
+    std::vector<TimerWheel::Entry> entries(count);
+    std::vector<uint64_t> deadlines(count);
+    std::vector<bool> armed(count);
+    unsigned fires = 0;
+
+    auto pick = [&]() {
+        auto now = nowMs();
+        switch (rng() % 4)
+        {
+            case 0:
+                return now - std::min<uint64_t>(now, rng() % 100);
+            case 1:
+                return now + rng() % 100;
+            case 2:
+                return now + rng() % (1 << 18);
+            default:
+                return now + rng() % (blockMs * 3);
+        }
+    };
+
+    for (size_t i = 0; i < count; i++)
+    {
+        entries[i].callback = [&, i](uint64_t) {
+            ASSERT_TRUE(armed[i]);
+            EXPECT_GE(nowMs(), deadlines[i]);
+            armed[i] = false;
+            fires++;
+            if (rng() % 3 == 0)
+            {
+                deadlines[i] = pick();
+                armed[i] = true;
+                arm(entries[i], deadlines[i]);
+            }
+        };
+        deadlines[i] = pick();
+        armed[i] = true;
+        arm(entries[i], deadlines[i]);
+    }
+
+    // Runs about 4 rounds of timers
+    while (fires < count * 4)
+    {
+        auto now = nowMs();
+        auto step = rng() % 2 ? rng() % 50 : rng() % (blockMs / 2);
+        advance(now + step);
+
+        for (size_t i = 0; i < count; i++)
+        {
+            // Nothing due is left behind
+            ASSERT_FALSE(armed[i] && deadlines[i] <= now + step) << i;
+
+            // Cancel and rearm some of the others
+            if (armed[i] && rng() % 50 == 0)
+            {
+                wheel->cancel(entries[i]);
+                armed[i] = false;
+            }
+            else if (!armed[i] && rng() % 10 == 0)
+            {
+                deadlines[i] = pick();
+                armed[i] = true;
+                arm(entries[i], deadlines[i]);
+            }
+        }
+    }
+}